@@ -253,13 +253,26 @@ static inline TranslationBlock *tb_lookup(CPUState *cpu, vaddr pc,
         goto hit;
     }
 
+    /*
+     * Check the victim way before the QHT.  An invalidated TB has
+     * CF_INVALID set and so can never match cflags here.
+     */
+    tb = qatomic_read(&jc->victim[hash].tb);
+    if (tb &&
+        jc->victim[hash].pc == pc &&
+        tb->cs_base == cs_base &&
+        tb->flags == flags &&
+        tb_cflags(tb) == cflags) {
+        tb_jmp_cache_insert(jc, hash, pc, tb);
+        goto hit;
+    }
+
     tb = tb_htable_lookup(cpu, pc, cs_base, flags, cflags);
     if (tb == NULL) {
         return NULL;
     }
 
-    jc->array[hash].pc = pc;
-    qatomic_set(&jc->array[hash].tb, tb);
+    tb_jmp_cache_insert(jc, hash, pc, tb);
 
 hit:
     /*
@@ -414,6 +427,7 @@ const void *HELPER(lookup_tb_ptr)(CPUArchState *env)
         log_cpu_exec(pc, cpu, tb);
     }
 
+    qatomic_set(&cpu->tcg_prof_tb, tb);
     return tb->tc.ptr;
 }
 
@@ -449,7 +463,10 @@ cpu_tb_exec(CPUState *cpu, TranslationBlock *itb, int *tb_exit)
     }
 
     qemu_thread_jit_execute();
+    qatomic_set(&cpu->tcg_prof_tb, itb);
+    tcg_prof_set(cpu, TCG_PROF_EXEC);
     ret = tcg_qemu_tb_exec(cpu_env(cpu), tb_ptr);
+    tcg_prof_set(cpu, TCG_PROF_OTHER);
     cpu->neg.can_do_io = true;
     qemu_plugin_disable_mem_helpers(cpu);
     /*
@@ -526,6 +543,7 @@ static void cpu_exec_longjmp_cleanup(CPUState *cpu)
 {
     /* Non-buggy compilers preserve this; assert the correct value. */
     g_assert(cpu == current_cpu);
+    tcg_prof_set(cpu, TCG_PROF_OTHER);
 
 #ifdef CONFIG_USER_ONLY
     clear_helper_retaddr();
@@ -980,21 +998,18 @@ cpu_exec_loop(CPUState *cpu, SyncClocks *sc)
 
             tb = tb_lookup(cpu, pc, cs_base, flags, cflags);
             if (tb == NULL) {
-                CPUJumpCache *jc;
-                uint32_t h;
-
+                tcg_prof_set(cpu, TCG_PROF_TRANSLATE);
                 mmap_lock();
                 tb = tb_gen_code(cpu, pc, cs_base, flags, cflags);
                 mmap_unlock();
+                tcg_prof_set(cpu, TCG_PROF_OTHER);
 
                 /*
                  * We add the TB in the virtual pc hash table
                  * for the fast lookup
                  */
-                h = tb_jmp_cache_hash_func(pc);
-                jc = cpu->tb_jmp_cache;
-                jc->array[h].pc = pc;
-                qatomic_set(&jc->array[h].tb, tb);
+                tb_jmp_cache_insert(cpu->tb_jmp_cache,
+                                    tb_jmp_cache_hash_func(pc), pc, tb);
             }
 
 #ifndef CONFIG_USER_ONLY
@@ -32,6 +32,7 @@
 #include "exec/tlb-common.h"
 #include "exec/vaddr.h"
 #include "tcg/tcg.h"
+#include "system/tcg.h"
 #include "qemu/error-report.h"
 #include "exec/log.h"
 #include "exec/helper-proto-common.h"
@@ -155,6 +156,7 @@ static void tb_jmp_cache_clear_page(CPUState *cpu, vaddr page_addr)
     i0 = tb_jmp_cache_hash_page(page_addr);
     for (i = 0; i < TB_JMP_PAGE_SIZE; i++) {
         qatomic_set(&jc->array[i0 + i].tb, NULL);
+        qatomic_set(&jc->victim[i0 + i].tb, NULL);
     }
 }
 
@@ -247,6 +249,7 @@ static void tlb_mmu_resize_locked(CPUTLBDesc *desc, CPUTLBDescFast *fast,
 
     tlb_window_reset(desc, now, 0);
     /* desc->n_used_entries is cleared by the caller */
+    desc->n_fill_log = CPU_TLB_FILL_LOG_SIZE + 1;
     fast->mask = (new_size - 1) << CPU_TLB_ENTRY_BITS;
     fast->table = g_try_new(CPUTLBEntry, new_size);
     desc->fulltlb = g_try_new(CPUTLBEntryFull, new_size);
@@ -279,8 +282,21 @@ static void tlb_mmu_flush_locked(CPUTLBDesc *desc, CPUTLBDescFast *fast)
     desc->large_page_addr = -1;
     desc->large_page_mask = -1;
     desc->vindex = 0;
-    memset(fast->table, -1, sizeof_tlb(fast));
+    /*
+     * Most flushes happen long before the table fills up; for those,
+     * only clear the entries that have been filled in the meantime.
+     */
+    if (desc->n_fill_log <= CPU_TLB_FILL_LOG_SIZE) {
+        for (size_t i = 0; i < desc->n_fill_log; i++) {
+            memset(&fast->table[desc->fill_log[i]], -1, sizeof(CPUTLBEntry));
+        }
+    } else {
+        memset(fast->table, -1, sizeof_tlb(fast));
+    }
+    desc->n_fill_log = 0;
     memset(desc->vtable, -1, sizeof(desc->vtable));
+    memset(desc->large_addr, -1, sizeof(desc->large_addr));
+    desc->large_next = 0;
 }
 
 static void tlb_flush_one_mmuidx_locked(CPUState *cpu, int mmu_idx,
@@ -302,6 +318,7 @@ static void tlb_mmu_init(CPUTLBDesc *desc, CPUTLBDescFast *fast, int64_t now)
     fast->mask = (n_entries - 1) << CPU_TLB_ENTRY_BITS;
     fast->table = g_new(CPUTLBEntry, n_entries);
     desc->fulltlb = g_new(CPUTLBEntryFull, n_entries);
+    desc->n_fill_log = CPU_TLB_FILL_LOG_SIZE + 1;
     tlb_mmu_flush_locked(desc, fast);
 }
 
@@ -324,6 +341,10 @@ void tlb_init(CPUState *cpu)
 
     /* All tlbs are initialized flushed. */
     cpu->neg.tlb.c.dirty = 0;
+    cpu->neg.tlb.c.pending_scheduled = false;
+    cpu->neg.tlb.c.pending_full = 0;
+    cpu->neg.tlb.c.n_pending = 0;
+    cpu->neg.tlb.c.walk_valid = 0;
 
     for (i = 0; i < NB_MMU_MODES; i++) {
         tlb_mmu_init(&cpu->neg.tlb.d[i], &cpu->neg.tlb.f[i], now);
@@ -375,6 +396,7 @@ static void tlb_flush_by_mmuidx_async_work(CPUState *cpu, run_on_cpu_data data)
 
     qemu_spin_lock(&cpu->neg.tlb.c.lock);
 
+    cpu->neg.tlb.c.walk_valid = 0;
     all_dirty = cpu->neg.tlb.c.dirty;
     to_clean = asked & all_dirty;
     all_dirty &= ~to_clean;
@@ -387,7 +409,13 @@ static void tlb_flush_by_mmuidx_async_work(CPUState *cpu, run_on_cpu_data data)
 
     qemu_spin_unlock(&cpu->neg.tlb.c.lock);
 
-    tcg_flush_jmp_cache(cpu);
+    /*
+     * Filling the tlb is a prerequisite for finding a TB via any of
+     * the asked mmu_idx; if they are all clean, so is the jump cache.
+     */
+    if (to_clean) {
+        tcg_flush_jmp_cache(cpu);
+    }
 
     if (to_clean == ALL_MMUIDX_BITS) {
         qatomic_set(&cpu->neg.tlb.c.full_flush_count,
@@ -457,6 +485,21 @@ static inline bool tlb_entry_is_empty(const CPUTLBEntry *te)
     return te->addr_read == -1 && te->addr_write == -1 && te->addr_code == -1;
 }
 
+/* Record that fast table entry @index is about to be filled. */
+static inline void tlb_fill_log_locked(CPUTLBDesc *desc, CPUTLBEntry *te,
+                                       size_t index)
+{
+    if (!tlb_entry_is_empty(te)) {
+        /* Already logged since the last flush. */
+        return;
+    }
+    if (desc->n_fill_log < CPU_TLB_FILL_LOG_SIZE) {
+        desc->fill_log[desc->n_fill_log++] = index;
+    } else {
+        desc->n_fill_log = CPU_TLB_FILL_LOG_SIZE + 1;
+    }
+}
+
 /* Called with tlb_c.lock held */
 static bool tlb_flush_entry_mask_locked(CPUTLBEntry *tlb_entry,
                                         vaddr page,
@@ -535,6 +578,7 @@ static void tlb_flush_page_by_mmuidx_async_0(CPUState *cpu,
     tlb_debug("page addr: %016" VADDR_PRIx " mmu_map:0x%x\n", addr, idxmap);
 
     qemu_spin_lock(&cpu->neg.tlb.c.lock);
+    cpu->neg.tlb.c.walk_valid = 0;
     for (mmu_idx = 0; mmu_idx < NB_MMU_MODES; mmu_idx++) {
         if ((idxmap >> mmu_idx) & 1) {
             tlb_flush_page_locked(cpu, mmu_idx, addr);
@@ -707,13 +751,6 @@ static void tlb_flush_range_locked(CPUState *cpu, int midx,
     }
 }
 
-typedef struct {
-    vaddr addr;
-    vaddr len;
-    uint16_t idxmap;
-    uint16_t bits;
-} TLBFlushRangeData;
-
 static void tlb_flush_range_by_mmuidx_async_0(CPUState *cpu,
                                               TLBFlushRangeData d)
 {
@@ -725,6 +762,7 @@ static void tlb_flush_range_by_mmuidx_async_0(CPUState *cpu,
               d.addr, d.bits, d.len, d.idxmap);
 
     qemu_spin_lock(&cpu->neg.tlb.c.lock);
+    cpu->neg.tlb.c.walk_valid = 0;
     for (mmu_idx = 0; mmu_idx < NB_MMU_MODES; mmu_idx++) {
         if ((d.idxmap >> mmu_idx) & 1) {
             tlb_flush_range_locked(cpu, mmu_idx, d.addr, d.len, d.bits);
@@ -760,6 +798,99 @@ static void tlb_flush_range_by_mmuidx_async_1(CPUState *cpu,
     g_free(d);
 }
 
+/* Apply the range flushes queued by tlb_flush_range_queue. */
+static void tlb_flush_range_pending_async_work(CPUState *cpu,
+                                               run_on_cpu_data data)
+{
+    TLBFlushRangeData pending[CPU_TLB_PENDING_SIZE];
+    uint16_t full;
+    unsigned i, n;
+
+    qemu_spin_lock(&cpu->neg.tlb.c.lock);
+    full = cpu->neg.tlb.c.pending_full;
+    n = cpu->neg.tlb.c.n_pending;
+    memcpy(pending, cpu->neg.tlb.c.pending, n * sizeof(pending[0]));
+    cpu->neg.tlb.c.pending_full = 0;
+    cpu->neg.tlb.c.n_pending = 0;
+    cpu->neg.tlb.c.pending_scheduled = false;
+    qemu_spin_unlock(&cpu->neg.tlb.c.lock);
+
+    if (full) {
+        tlb_flush_by_mmuidx_async_work(cpu, RUN_ON_CPU_HOST_INT(full));
+    }
+    for (i = 0; i < n; i++) {
+        tlb_flush_range_by_mmuidx_async_0(cpu, pending[i]);
+    }
+}
+
+/*
+ * Queue a range flush for @cpu, coalescing it with the flushes already
+ * pending there, so that a burst of broadcast invalidations costs each
+ * remote cpu a single work item.
+ */
+static void tlb_flush_range_queue(CPUState *cpu, const TLBFlushRangeData *d)
+{
+    CPUTLBCommon *c = &cpu->neg.tlb.c;
+    vaddr last = d->addr + d->len - 1;
+    bool merged = true;
+    bool schedule;
+    unsigned i;
+
+    qemu_spin_lock(&c->lock);
+    if ((d->idxmap & ~c->pending_full) == 0) {
+        /* Already covered by a pending full flush. */
+        goto done;
+    }
+    for (i = 0; i < c->n_pending; i++) {
+        TLBFlushRangeData *p = &c->pending[i];
+        vaddr p_last = p->addr + p->len - 1;
+
+        /*
+         * Merge overlapping or adjacent ranges for the same mmu_idx.
+         * Compare without adding 1 to the last addresses, which may be
+         * the top of the address space.
+         */
+        if (p->idxmap == d->idxmap && p->bits == d->bits &&
+            (d->addr <= p_last || d->addr - p_last == 1) &&
+            (p->addr <= last || p->addr - last == 1)) {
+            p->addr = MIN(p->addr, d->addr);
+            p_last = MAX(p_last, last);
+            if (p->addr == 0 && p_last == (vaddr)-1) {
+                /* The length of the whole space does not fit in len. */
+                c->pending_full |= p->idxmap;
+                c->pending[i] = c->pending[--c->n_pending];
+            } else {
+                p->len = p_last - p->addr + 1;
+            }
+            goto done;
+        }
+    }
+    if (c->n_pending < CPU_TLB_PENDING_SIZE) {
+        c->pending[c->n_pending++] = *d;
+        merged = false;
+    } else {
+        /* Too many distinct ranges: flush everything they touch. */
+        for (i = 0; i < c->n_pending; i++) {
+            c->pending_full |= c->pending[i].idxmap;
+        }
+        c->pending_full |= d->idxmap;
+        c->n_pending = 0;
+    }
+
+ done:
+    schedule = !c->pending_scheduled;
+    c->pending_scheduled = true;
+    if (merged) {
+        qatomic_set(&c->merge_flush_count, c->merge_flush_count + 1);
+    }
+    qemu_spin_unlock(&c->lock);
+
+    if (schedule) {
+        async_run_on_cpu(cpu, tlb_flush_range_pending_async_work,
+                         RUN_ON_CPU_NULL);
+    }
+}
+
 void tlb_flush_range_by_mmuidx(CPUState *cpu, vaddr addr,
                                vaddr len, uint16_t idxmap,
                                unsigned bits)
@@ -826,12 +957,9 @@ void tlb_flush_range_by_mmuidx_all_cpus_synced(CPUState *src_cpu,
     d.idxmap = idxmap;
     d.bits = bits;
 
-    /* Allocate a separate data block for each destination cpu.  */
     CPU_FOREACH(dst_cpu) {
         if (dst_cpu != src_cpu) {
-            p = g_memdup(&d, sizeof(d));
-            async_run_on_cpu(dst_cpu, tlb_flush_range_by_mmuidx_async_1,
-                             RUN_ON_CPU_HOST_PTR(p));
+            tlb_flush_range_queue(dst_cpu, &d);
         }
     }
 
@@ -990,6 +1118,40 @@ static void tlb_add_large_page(CPUState *cpu, int mmu_idx,
     cpu->neg.tlb.d[mmu_idx].large_page_mask = lp_mask;
 }
 
+/*
+ * Remember the linear mapping described by @full, so that
+ * tlb_fill_large_page can fill its other pages.  Only lg_map_size
+ * describes such a mapping: lg_page_size may be larger than it.
+ * Pages which must be re-checked by the target on every write are
+ * not remembered.
+ */
+static void tlb_remember_large_page(CPUTLBDesc *desc, vaddr addr,
+                                    const CPUTLBEntryFull *full)
+{
+    vaddr mask = -(vaddr)1 << full->lg_map_size;
+    vaddr base = addr & mask;
+    size_t i;
+
+    if (full->lg_map_size <= TARGET_PAGE_BITS ||
+        (full->prot & PAGE_WRITE_INV)) {
+        return;
+    }
+    /* Replace an older copy of the same page, e.g. with fewer rights. */
+    for (i = 0; i < CPU_TLB_LARGE_SIZE; i++) {
+        if (desc->large_addr[i] == base &&
+            desc->large_full[i].lg_map_size == full->lg_map_size) {
+            break;
+        }
+    }
+    if (i == CPU_TLB_LARGE_SIZE) {
+        i = desc->large_next++ % CPU_TLB_LARGE_SIZE;
+    }
+    desc->large_addr[i] = base;
+    desc->large_full[i] = *full;
+    desc->large_full[i].phys_addr = (full->phys_addr & TARGET_PAGE_MASK) -
+                                    ((addr & TARGET_PAGE_MASK) - base);
+}
+
 static inline void tlb_set_compare(CPUTLBEntryFull *full, CPUTLBEntry *ent,
                                    vaddr address, int flags,
                                    MMUAccessType access_type, bool enable)
@@ -1038,6 +1200,7 @@ void tlb_set_page_full(CPUState *cpu, int mmu_idx,
         sz = (hwaddr)1 << full->lg_page_size;
         tlb_add_large_page(cpu, mmu_idx, addr, sz);
     }
+    tlb_remember_large_page(desc, addr, full);
     addr_page = addr & TARGET_PAGE_MASK;
     paddr_page = full->phys_addr & TARGET_PAGE_MASK;
 
@@ -1173,6 +1336,7 @@ void tlb_set_page_full(CPUState *cpu, int mmu_idx,
     tlb_set_compare(full, &tn, addr_page, write_flags,
                     MMU_DATA_STORE, prot & PAGE_WRITE);
 
+    tlb_fill_log_locked(desc, te, index);
     copy_tlb_helper_locked(te, &tn);
     tlb_n_used_entries_inc(cpu, mmu_idx);
     qemu_spin_unlock(&tlb->c.lock);
@@ -1201,6 +1365,38 @@ void tlb_set_page(CPUState *cpu, vaddr addr,
                             prot, mmu_idx, size);
 }
 
+static inline unsigned tlb_walk_cache_index(hwaddr addr)
+{
+    /* Descriptors are at least 4 bytes; hash on the table index. */
+    return (addr >> 2) & (CPU_TLB_WALK_CACHE_SIZE - 1);
+}
+
+bool tlb_walk_cache_lookup(CPUState *cpu, hwaddr addr, uint64_t *pval)
+{
+    CPUTLBCommon *c = &cpu->neg.tlb.c;
+    unsigned i = tlb_walk_cache_index(addr);
+
+    if ((c->walk_valid & (1u << i)) && c->walk[i].addr == addr) {
+        *pval = c->walk[i].val;
+        return true;
+    }
+    return false;
+}
+
+void tlb_walk_cache_insert(CPUState *cpu, hwaddr addr, uint64_t val)
+{
+    CPUTLBCommon *c = &cpu->neg.tlb.c;
+    unsigned i = tlb_walk_cache_index(addr);
+
+    /* Without tcg, nothing would ever flush the cache. */
+    if (!tcg_enabled()) {
+        return;
+    }
+    c->walk[i].addr = addr;
+    c->walk[i].val = val;
+    c->walk_valid |= 1u << i;
+}
+
 /**
  * tlb_hit_page: return true if page aligned @addr is a hit against the
  * TLB entry @tlb_addr
@@ -1224,20 +1420,79 @@ static inline bool tlb_hit(uint64_t tlb_addr, vaddr addr)
     return tlb_hit_page(tlb_addr, addr & TARGET_PAGE_MASK);
 }
 
+static inline void cpu_unaligned_access(CPUState *cpu, vaddr addr,
+                                        MMUAccessType access_type,
+                                        int mmu_idx, uintptr_t retaddr)
+{
+    cpu->cc->tcg_ops->do_unaligned_access(cpu, addr, access_type,
+                                          mmu_idx, retaddr);
+}
+
 /*
- * Note: tlb_fill_align() can trigger a resize of the TLB.
- * This means that all of the caller's prior references to the TLB table
- * (e.g. CPUTLBEntry pointers) must be discarded and looked up again
- * (e.g. via tlb_entry()).
+ * Fill the tlb entry for @addr from a linear mapping remembered by
+ * tlb_remember_large_page, without calling the target.
+ * Returns false if there is no suitable mapping, or if @probe
+ * and the access is misaligned: leave those to the target.
  */
-static bool tlb_fill_align(CPUState *cpu, vaddr addr, MMUAccessType type,
-                           int mmu_idx, MemOp memop, int size,
-                           bool probe, uintptr_t ra)
+static bool tlb_fill_large_page(CPUState *cpu, vaddr addr,
+                                MMUAccessType type, int mmu_idx,
+                                MemOp memop, bool probe, uintptr_t ra)
+{
+    static const int need_prot[] = {
+        [MMU_DATA_LOAD] = PAGE_READ,
+        [MMU_DATA_STORE] = PAGE_WRITE,
+        [MMU_INST_FETCH] = PAGE_EXEC,
+    };
+    CPUTLBDesc *desc = &cpu->neg.tlb.d[mmu_idx];
+    CPUTLBEntryFull full;
+    int a_bits;
+    size_t i;
+
+    for (i = 0; i < CPU_TLB_LARGE_SIZE; i++) {
+        vaddr mask;
+
+        if (desc->large_addr[i] == (vaddr)-1) {
+            continue;
+        }
+        mask = -(vaddr)1 << desc->large_full[i].lg_map_size;
+        if ((addr & mask) == desc->large_addr[i] &&
+            (desc->large_full[i].prot & need_prot[type])) {
+            break;
+        }
+    }
+    if (i == CPU_TLB_LARGE_SIZE) {
+        return false;
+    }
+    full = desc->large_full[i];
+
+    /* As in mmu_lookup1, for an entry already present in the tlb. */
+    a_bits = memop_alignment_bits(memop);
+    if (full.tlb_fill_flags & TLB_CHECK_ALIGNED) {
+        a_bits = MAX(a_bits, memop_atomicity_bits(memop));
+    }
+    if (addr & ((1 << a_bits) - 1)) {
+        if (probe) {
+            return false;
+        }
+        cpu_unaligned_access(cpu, addr, type, mmu_idx, ra);
+    }
+
+    full.phys_addr += (addr & TARGET_PAGE_MASK) - desc->large_addr[i];
+    tlb_set_page_full(cpu, mmu_idx, addr, &full);
+    return true;
+}
+
+static bool tlb_fill_align_1(CPUState *cpu, vaddr addr, MMUAccessType type,
+                             int mmu_idx, MemOp memop, int size,
+                             bool probe, uintptr_t ra)
 {
     const TCGCPUOps *ops = cpu->cc->tcg_ops;
     CPUTLBEntryFull full;
 
     if (ops->tlb_fill_align) {
+        if (tlb_fill_large_page(cpu, addr, type, mmu_idx, memop, probe, ra)) {
+            return true;
+        }
         if (ops->tlb_fill_align(cpu, &full, addr, type, mmu_idx,
                                 memop, size, probe, ra)) {
             tlb_set_page_full(cpu, mmu_idx, addr, &full);
@@ -1248,6 +1503,9 @@ static bool tlb_fill_align(CPUState *cpu, vaddr addr, MMUAccessType type,
         if (addr & ((1u << memop_alignment_bits(memop)) - 1)) {
             ops->do_unaligned_access(cpu, addr, type, mmu_idx, ra);
         }
+        if (tlb_fill_large_page(cpu, addr, type, mmu_idx, memop, probe, ra)) {
+            return true;
+        }
         if (ops->tlb_fill(cpu, addr, size, type, mmu_idx, probe, ra)) {
             return true;
         }
@@ -1256,12 +1514,23 @@ static bool tlb_fill_align(CPUState *cpu, vaddr addr, MMUAccessType type,
     return false;
 }
 
-static inline void cpu_unaligned_access(CPUState *cpu, vaddr addr,
-                                        MMUAccessType access_type,
-                                        int mmu_idx, uintptr_t retaddr)
+/*
+ * Note: tlb_fill_align() can trigger a resize of the TLB.
+ * This means that all of the caller's prior references to the TLB table
+ * (e.g. CPUTLBEntry pointers) must be discarded and looked up again
+ * (e.g. via tlb_entry()).
+ */
+static bool tlb_fill_align(CPUState *cpu, vaddr addr, MMUAccessType type,
+                           int mmu_idx, MemOp memop, int size,
+                           bool probe, uintptr_t ra)
 {
-    cpu->cc->tcg_ops->do_unaligned_access(cpu, addr, access_type,
-                                          mmu_idx, retaddr);
+    int prof_state = qatomic_read(&cpu->tcg_prof_state);
+    bool ret;
+
+    tcg_prof_set(cpu, TCG_PROF_TLB_FILL);
+    ret = tlb_fill_align_1(cpu, addr, type, mmu_idx, memop, size, probe, ra);
+    tcg_prof_set(cpu, prof_state);
+    return ret;
 }
 
 static MemoryRegionSection *
@@ -1313,6 +1582,7 @@ static bool victim_tlb_hit(CPUState *cpu, size_t mmu_idx, size_t index,
             CPUTLBEntry tmptlb, *tlb = &cpu->neg.tlb.f[mmu_idx].table[index];
 
             qemu_spin_lock(&cpu->neg.tlb.c.lock);
+            tlb_fill_log_locked(&cpu->neg.tlb.d[mmu_idx], tlb, index);
             copy_tlb_helper_locked(&tmptlb, tlb);
             copy_tlb_helper_locked(tlb, vtlb);
             copy_tlb_helper_locked(vtlb, &tmptlb);
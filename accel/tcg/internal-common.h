@@ -28,6 +28,26 @@ static inline bool cpu_in_serial_context(CPUState *cs)
     return !tcg_cflags_has(cs, CF_PARALLEL) || cpu_in_exclusive_context(cs);
 }
 
+/*
+ * What a vCPU is doing, as recorded for the sampling profiler behind
+ * x-query-tcg-profile.  The vCPU thread records the first four states
+ * itself; the sampler derives the last two from the CPU state.
+ */
+typedef enum TCGProfState {
+    TCG_PROF_OTHER,      /* in the cpu_exec loop, outside generated code */
+    TCG_PROF_EXEC,       /* in generated code, or a helper called from it */
+    TCG_PROF_TLB_FILL,   /* resolving a softmmu TLB miss */
+    TCG_PROF_TRANSLATE,  /* generating code */
+    TCG_PROF_IDLE,       /* outside cpu_exec */
+    TCG_PROF_EXCLUSIVE,  /* in or stopped for an exclusive section */
+    TCG_PROF__MAX,
+} TCGProfState;
+
+static inline void tcg_prof_set(CPUState *cpu, TCGProfState state)
+{
+    qatomic_set(&cpu->tcg_prof_state, state);
+}
+
 /**
  * cpu_plugin_mem_cbs_enabled() - are plugin memory callbacks enabled?
  * @cs: CPUState pointer
@@ -52,6 +72,7 @@ void page_init(void);
 void tb_htable_init(void);
 void tb_reset_jump(TranslationBlock *tb, int n);
 TranslationBlock *tb_link_page(TranslationBlock *tb);
+void tb_reclaim(CPUState *cpu);
 void cpu_restore_state_from_tb(CPUState *cpu, TranslationBlock *tb,
                                uintptr_t host_pc);
 
@@ -9,10 +9,14 @@
 #include "qemu/osdep.h"
 #include "qemu/accel.h"
 #include "qemu/qht.h"
+#include "qemu/timer.h"
 #include "qapi/error.h"
 #include "qapi/type-helpers.h"
 #include "qapi/qapi-commands-machine.h"
+#include "qobject/qdict.h"
 #include "monitor/monitor.h"
+#include "monitor/hmp.h"
+#include "hw/core/cpu.h"
 #include "system/cpu-timers.h"
 #include "system/tcg.h"
 #include "tcg/tcg.h"
@@ -125,19 +129,22 @@ static gboolean tb_tree_stats_iter(gpointer key, gpointer value, gpointer data)
     return false;
 }
 
-static void tlb_flush_counts(size_t *pfull, size_t *ppart, size_t *pelide)
+static void tlb_flush_counts(size_t *pfull, size_t *ppart, size_t *pelide,
+                             size_t *pmerge)
 {
     CPUState *cpu;
-    size_t full = 0, part = 0, elide = 0;
+    size_t full = 0, part = 0, elide = 0, merge = 0;
 
     CPU_FOREACH(cpu) {
         full += qatomic_read(&cpu->neg.tlb.c.full_flush_count);
         part += qatomic_read(&cpu->neg.tlb.c.part_flush_count);
         elide += qatomic_read(&cpu->neg.tlb.c.elide_flush_count);
+        merge += qatomic_read(&cpu->neg.tlb.c.merge_flush_count);
     }
     *pfull = full;
     *ppart = part;
     *pelide = elide;
+    *pmerge = merge;
 }
 
 static void tcg_dump_info(GString *buf)
@@ -149,7 +156,7 @@ static void dump_exec_info(GString *buf)
 {
     struct tb_tree_stats tst = {};
     struct qht_stats hst;
-    size_t nb_tbs, flush_full, flush_part, flush_elide;
+    size_t nb_tbs, flush_full, flush_part, flush_elide, flush_merge;
 
     tcg_tb_foreach(tb_tree_stats_iter, &tst);
     nb_tbs = tst.nb_tbs;
@@ -188,13 +195,19 @@ static void dump_exec_info(GString *buf)
     g_string_append_printf(buf, "\nStatistics:\n");
     g_string_append_printf(buf, "TB flush count      %u\n",
                            qatomic_read(&tb_ctx.tb_flush_count));
+    g_string_append_printf(buf, "TB evict count      %u\n",
+                           qatomic_read(&tb_ctx.tb_evict_count));
     g_string_append_printf(buf, "TB invalidate count %u\n",
                            qatomic_read(&tb_ctx.tb_phys_invalidate_count));
+    g_string_append_printf(buf, "TB translate count  %u (%u discarded)\n",
+                           qatomic_read(&tb_ctx.tb_gen_count),
+                           qatomic_read(&tb_ctx.tb_gen_discard_count));
 
-    tlb_flush_counts(&flush_full, &flush_part, &flush_elide);
+    tlb_flush_counts(&flush_full, &flush_part, &flush_elide, &flush_merge);
     g_string_append_printf(buf, "TLB full flushes    %zu\n", flush_full);
     g_string_append_printf(buf, "TLB partial flushes %zu\n", flush_part);
     g_string_append_printf(buf, "TLB elided flushes  %zu\n", flush_elide);
+    g_string_append_printf(buf, "TLB merged flushes  %zu\n", flush_merge);
     tcg_dump_info(buf);
 }
 
@@ -234,10 +247,280 @@ HumanReadableText *qmp_x_query_opcount(Error **errp)
     return human_readable_text_from_str(buf);
 }
 
+/*
+ * Sampling execution profile.  Every TCG_PROF_PERIOD_MS, the main loop
+ * records what each vCPU is doing, and while it runs guest code, which
+ * TB it entered last.  Guest code covers both generated code and the
+ * helpers it calls, except for softmmu TLB fills, which are counted on
+ * their own; the two are not told apart.  Chained direct jumps do not
+ * update the TB, so samples are attributed to the head of the chain the
+ * vCPU entered through cpu_exec or helper_lookup_tb_ptr.
+ */
+#define TCG_PROF_PERIOD_MS  10
+#define TCG_PROF_TOP_N      20
+
+typedef struct TCGProfBlock {
+    /* Blocks are keyed by the ram address of their first insn. */
+    uint64_t ram_addr;
+    vaddr pc;
+    bool pcrel;
+    uint64_t samples;
+} TCGProfBlock;
+
+static QEMUTimer *tcg_prof_timer;
+static GHashTable *tcg_prof_blocks;
+static uint64_t tcg_prof_samples[TCG_PROF__MAX];
+
+static const char * const tcg_prof_state_names[TCG_PROF__MAX] = {
+    [TCG_PROF_OTHER] = "cpu_exec loop",
+    [TCG_PROF_EXEC] = "guest code",
+    [TCG_PROF_TLB_FILL] = "tlb fill",
+    [TCG_PROF_TRANSLATE] = "translation",
+    [TCG_PROF_IDLE] = "idle",
+    [TCG_PROF_EXCLUSIVE] = "exclusive",
+};
+
+/* Frame names for the folded format, which separates frames by spaces */
+static const char * const tcg_prof_state_frames[TCG_PROF__MAX] = {
+    [TCG_PROF_OTHER] = "cpu_exec_loop",
+    [TCG_PROF_EXEC] = "guest_code",
+    [TCG_PROF_TLB_FILL] = "tlb_fill",
+    [TCG_PROF_TRANSLATE] = "translation",
+    [TCG_PROF_IDLE] = "idle",
+    [TCG_PROF_EXCLUSIVE] = "exclusive",
+};
+
+static void tcg_prof_sample_tb(const TranslationBlock *tb)
+{
+    uint64_t ram_addr = tb_page_addr0(tb);
+    TCGProfBlock *blk = g_hash_table_lookup(tcg_prof_blocks, &ram_addr);
+
+    if (!blk) {
+        blk = g_new0(TCGProfBlock, 1);
+        blk->ram_addr = ram_addr;
+        blk->pcrel = tb_cflags(tb) & CF_PCREL;
+        blk->pc = tb->pc;
+        g_hash_table_insert(tcg_prof_blocks, &blk->ram_addr, blk);
+    }
+    blk->samples++;
+}
+
+static void tcg_prof_tick(void *opaque)
+{
+    bool exclusive = false;
+    CPUState *cpu;
+
+    CPU_FOREACH(cpu) {
+        if (qatomic_read(&cpu->exclusive_context_count)) {
+            exclusive = true;
+        }
+    }
+
+    CPU_FOREACH(cpu) {
+        TCGProfState state;
+
+        if (exclusive) {
+            state = TCG_PROF_EXCLUSIVE;
+        } else if (!qatomic_read(&cpu->running)) {
+            state = TCG_PROF_IDLE;
+        } else {
+            state = qatomic_read(&cpu->tcg_prof_state);
+        }
+        tcg_prof_samples[state]++;
+
+        if (state == TCG_PROF_EXEC) {
+            /*
+             * The TB may be invalidated concurrently, but its storage
+             * stays mapped, so at worst this sample is misattributed.
+             */
+            const TranslationBlock *tb = qatomic_read(&cpu->tcg_prof_tb);
+            if (tb) {
+                tcg_prof_sample_tb(tb);
+            }
+        }
+    }
+
+    timer_mod(tcg_prof_timer,
+              qemu_clock_get_ms(QEMU_CLOCK_REALTIME) + TCG_PROF_PERIOD_MS);
+}
+
+static gint tcg_prof_block_cmp(gconstpointer a, gconstpointer b)
+{
+    const TCGProfBlock *ba = *(const TCGProfBlock **)a;
+    const TCGProfBlock *bb = *(const TCGProfBlock **)b;
+
+    return ba->samples < bb->samples ? 1 : ba->samples > bb->samples ? -1 : 0;
+}
+
+/* Return the sampled blocks, busiest first. */
+static GPtrArray *tcg_prof_sorted_blocks(void)
+{
+    GPtrArray *blocks;
+    GHashTableIter iter;
+    TCGProfBlock *blk;
+
+    blocks = g_ptr_array_sized_new(g_hash_table_size(tcg_prof_blocks));
+    g_hash_table_iter_init(&iter, tcg_prof_blocks);
+    while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&blk)) {
+        g_ptr_array_add(blocks, blk);
+    }
+    g_ptr_array_sort(blocks, tcg_prof_block_cmp);
+    return blocks;
+}
+
+static void tcg_dump_profile(GString *buf)
+{
+    g_autoptr(GPtrArray) blocks = NULL;
+    uint64_t total = 0;
+    TCGProfBlock *blk;
+    int i;
+
+    for (i = 0; i < TCG_PROF__MAX; i++) {
+        total += tcg_prof_samples[i];
+    }
+    g_string_append_printf(buf, "vCPU samples        %" PRIu64
+                           " (every %d ms)\n", total, TCG_PROF_PERIOD_MS);
+    if (!total) {
+        return;
+    }
+    for (i = 0; i < TCG_PROF__MAX; i++) {
+        g_string_append_printf(buf, "  %-17s %5.1f%%\n",
+                               tcg_prof_state_names[i],
+                               100.0 * tcg_prof_samples[i] / total);
+    }
+
+    if (!tcg_prof_samples[TCG_PROF_EXEC]) {
+        return;
+    }
+    blocks = tcg_prof_sorted_blocks();
+
+    g_string_append_printf(buf, "\nTop guest blocks in guest code:\n");
+    g_string_append_printf(buf, "  %-18s %-18s %10s %6s\n",
+                           "guest pc", "ram addr", "samples", "%");
+    for (i = 0; i < MIN(blocks->len, TCG_PROF_TOP_N); i++) {
+        blk = g_ptr_array_index(blocks, i);
+        if (blk->pcrel) {
+            g_string_append_printf(buf, "  %-18s", "-");
+        } else {
+            g_string_append_printf(buf, "  0x%016" VADDR_PRIx, blk->pc);
+        }
+        g_string_append_printf(buf, " 0x%016" PRIx64 " %10" PRIu64
+                               " %5.1f%%\n", blk->ram_addr, blk->samples,
+                               100.0 * blk->samples /
+                               tcg_prof_samples[TCG_PROF_EXEC]);
+    }
+}
+
+/*
+ * Dump the samples as folded stacks, as produced by stackcollapse-perf.pl
+ * from "perf script": frames separated by ';', then the sample count.
+ */
+static void tcg_dump_profile_folded(GString *buf)
+{
+    g_autoptr(GPtrArray) blocks = NULL;
+    uint64_t unattributed = tcg_prof_samples[TCG_PROF_EXEC];
+    TCGProfBlock *blk;
+    int i;
+
+    blocks = tcg_prof_sorted_blocks();
+    for (i = 0; i < blocks->len; i++) {
+        blk = g_ptr_array_index(blocks, i);
+        unattributed -= blk->samples;
+    }
+
+    for (i = 0; i < TCG_PROF__MAX; i++) {
+        uint64_t samples = i == TCG_PROF_EXEC ? unattributed
+                                              : tcg_prof_samples[i];
+        if (samples) {
+            g_string_append_printf(buf, "%s %" PRIu64 "\n",
+                                   tcg_prof_state_frames[i], samples);
+        }
+    }
+
+    for (i = 0; i < blocks->len; i++) {
+        blk = g_ptr_array_index(blocks, i);
+        g_string_append_printf(buf, "%s;",
+                               tcg_prof_state_frames[TCG_PROF_EXEC]);
+        if (blk->pcrel) {
+            g_string_append_printf(buf, "ram_0x%" PRIx64, blk->ram_addr);
+        } else {
+            g_string_append_printf(buf, "0x%" VADDR_PRIx, blk->pc);
+        }
+        g_string_append_printf(buf, " %" PRIu64 "\n", blk->samples);
+    }
+}
+
+static void tcg_prof_stop(void)
+{
+    timer_free(tcg_prof_timer);
+    tcg_prof_timer = NULL;
+    g_hash_table_destroy(tcg_prof_blocks);
+    tcg_prof_blocks = NULL;
+    memset(tcg_prof_samples, 0, sizeof(tcg_prof_samples));
+}
+
+HumanReadableText *qmp_x_query_tcg_profile(bool has_format,
+                                           TcgProfileFormat format,
+                                           bool has_stop, bool stop,
+                                           Error **errp)
+{
+    g_autoptr(GString) buf = g_string_new("");
+
+    if (!tcg_enabled()) {
+        error_setg(errp,
+                   "TCG profile information is only available with accel=tcg");
+        return NULL;
+    }
+
+    if (!tcg_prof_timer) {
+        if (stop) {
+            g_string_append_printf(buf,
+                                   "TCG profile sampling is not running\n");
+            return human_readable_text_from_str(buf);
+        }
+        tcg_prof_blocks = g_hash_table_new_full(g_int64_hash, g_int64_equal,
+                                                NULL, g_free);
+        tcg_prof_timer = timer_new_ms(QEMU_CLOCK_REALTIME,
+                                      tcg_prof_tick, NULL);
+        timer_mod(tcg_prof_timer,
+                  qemu_clock_get_ms(QEMU_CLOCK_REALTIME) + TCG_PROF_PERIOD_MS);
+        g_string_append_printf(buf, "TCG profile sampling started\n");
+        return human_readable_text_from_str(buf);
+    }
+
+    if (format == TCG_PROFILE_FORMAT_FOLDED) {
+        tcg_dump_profile_folded(buf);
+    } else {
+        tcg_dump_profile(buf);
+    }
+    if (stop) {
+        tcg_prof_stop();
+    }
+
+    return human_readable_text_from_str(buf);
+}
+
+static void hmp_info_tcg_profile(Monitor *mon, const QDict *qdict)
+{
+    bool folded = qdict_get_try_bool(qdict, "folded", false);
+    bool stop = qdict_get_try_bool(qdict, "stop", false);
+    g_autoptr(HumanReadableText) info = NULL;
+    Error *err = NULL;
+
+    info = qmp_x_query_tcg_profile(true, folded ? TCG_PROFILE_FORMAT_FOLDED :
+                                   TCG_PROFILE_FORMAT_SUMMARY,
+                                   true, stop, &err);
+    if (hmp_handle_error(mon, err)) {
+        return;
+    }
+    monitor_puts(mon, info->human_readable_text);
+}
+
 static void hmp_tcg_register(void)
 {
     monitor_register_hmp_info_hrt("jit", qmp_x_query_jit);
     monitor_register_hmp_info_hrt("opcount", qmp_x_query_opcount);
+    monitor_register_hmp("tcg-profile", true, hmp_info_tcg_profile);
 }
 
 type_init(hmp_tcg_register);
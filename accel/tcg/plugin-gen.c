@@ -130,9 +130,8 @@ static TCGv_ptr gen_plugin_u64_ptr(qemu_plugin_u64 entry)
 {
     TCGv_ptr ptr = tcg_temp_ebb_new_ptr();
 
-    GArray *arr = entry.score->data;
-    char *base_ptr = arr->data + entry.offset;
-    size_t entry_size = g_array_get_element_size(arr);
+    char *base_ptr = entry.score->data + entry.offset;
+    size_t entry_size = entry.score->element_size;
 
     TCGv_i32 cpu_index = gen_cpu_index();
     tcg_gen_muli_i32(cpu_index, cpu_index, entry_size);
@@ -221,6 +220,186 @@ static void gen_mem_cb(struct qemu_plugin_regular_cb *cb,
     tcg_temp_free_i32(cpu_index);
 }
 
+/*
+ * Append one record to the vCPU's trace buffer.  This is emitted right
+ * after a guest memory operation, where ebb temps of the surrounding
+ * expansion (e.g. the non-atomic read-modify-write sequences) may still
+ * be live, so it must not branch.  Room for the record was reserved by
+ * gen_mem_buffer_reserve() at the start of the instruction, unless there
+ * was not enough, the instruction loops, or its helpers queue records
+ * too: then call the out of line append, which drains the buffer itself
+ * when it is full.
+ */
+static void gen_mem_buffer_cb(struct qemu_plugin_buffer_cb *cb,
+                              qemu_plugin_meminfo_t meminfo, TCGv_i64 addr)
+{
+    qemu_plugin_u64 entry = { .score = cb->buf->score, .offset = 0 };
+    TCGv_ptr ptr, rec;
+    TCGv_i64 len, ofs;
+
+    if (cb->use_append) {
+        TCGv_i32 cpu_index = gen_cpu_index();
+        tcg_gen_call5(cb->append, cb->append_info, NULL,
+                      tcgv_i32_temp(cpu_index),
+                      tcgv_i32_temp(tcg_constant_i32(meminfo)),
+                      tcgv_i64_temp(addr),
+                      tcgv_i64_temp(tcg_constant_i64(cb->insn_vaddr)),
+                      tcgv_ptr_temp(tcg_constant_ptr(cb->buf)));
+        tcg_temp_free_i32(cpu_index);
+        return;
+    }
+
+    ptr = gen_plugin_u64_ptr(entry);
+    rec = tcg_temp_ebb_new_ptr();
+    len = tcg_temp_ebb_new_i64();
+    ofs = tcg_temp_ebb_new_i64();
+
+    tcg_gen_ld_i64(len, ptr, 0);
+    tcg_gen_muli_i64(ofs, len, sizeof(qemu_plugin_mem_record));
+    tcg_gen_trunc_i64_ptr(rec, ofs);
+    tcg_gen_add_ptr(rec, rec, ptr);
+
+    tcg_gen_st_i64(addr, rec, PLUGIN_MEM_BUFFER_HDR +
+                   offsetof(qemu_plugin_mem_record, vaddr));
+    tcg_gen_st_i64(tcg_constant_i64(cb->insn_vaddr), rec,
+                   PLUGIN_MEM_BUFFER_HDR +
+                   offsetof(qemu_plugin_mem_record, insn_vaddr));
+    tcg_gen_st_i32(tcg_constant_i32(meminfo), rec,
+                   PLUGIN_MEM_BUFFER_HDR +
+                   offsetof(qemu_plugin_mem_record, info));
+
+    tcg_gen_addi_i64(len, len, 1);
+    tcg_gen_st_i64(len, ptr, 0);
+
+    tcg_temp_free_i64(ofs);
+    tcg_temp_free_i64(len);
+    tcg_temp_free_ptr(rec);
+    tcg_temp_free_ptr(ptr);
+}
+
+/*
+ * At the start of an instruction, drain the trace buffer if it cannot
+ * hold another @n records.  If it cannot hold them even when empty, the
+ * records of this instruction are appended out of line instead.
+ */
+static void gen_mem_buffer_reserve(struct qemu_plugin_buffer_cb *cb, int n)
+{
+    struct qemu_plugin_mem_buffer *buf = cb->buf;
+    qemu_plugin_u64 entry = { .score = buf->score, .offset = 0 };
+    TCGv_ptr ptr;
+    TCGv_i64 len;
+    TCGLabel *after_cb;
+
+    if (n > (int)buf->n_records) {
+        cb->use_append = true;
+        return;
+    }
+
+    ptr = gen_plugin_u64_ptr(entry);
+    len = tcg_temp_ebb_new_i64();
+    after_cb = gen_new_label();
+
+    tcg_gen_ld_i64(len, ptr, 0);
+    tcg_gen_brcondi_i64(TCG_COND_LEU, len, buf->n_records - n, after_cb);
+    TCGv_i32 cpu_index = gen_cpu_index();
+    tcg_gen_call2(cb->drain, cb->info, NULL,
+                  tcgv_i32_temp(cpu_index),
+                  tcgv_ptr_temp(tcg_constant_ptr(buf)));
+    tcg_temp_free_i32(cpu_index);
+    gen_set_label(after_cb);
+
+    tcg_temp_free_i64(len);
+    tcg_temp_free_ptr(ptr);
+}
+
+/* Return the label @op branches to, or NULL. */
+static TCGLabel *plugin_op_branch_label(const TCGOp *op)
+{
+    switch (op->opc) {
+    case INDEX_op_br:
+        return arg_label(op->args[0]);
+    case INDEX_op_brcond_i32:
+    case INDEX_op_brcond_i64:
+        return arg_label(op->args[3]);
+    case INDEX_op_brcond2_i32:
+        return arg_label(op->args[5]);
+    default:
+        return NULL;
+    }
+}
+
+/*
+ * Count the memory operations of the instruction starting after @op.
+ * Return -1 if the instruction branches back to one of its own labels:
+ * its memory operations may then run any number of times, e.g. in the
+ * loop gen_sve_ldr() emits for long vectors.
+ */
+static int plugin_insn_mem_ops(TCGOp *op)
+{
+    g_autoptr(GPtrArray) labels = g_ptr_array_new();
+    TCGLabel *l;
+    int n = 0;
+
+    while ((op = QTAILQ_NEXT(op, link)) != NULL &&
+           op->opc != INDEX_op_insn_start) {
+        if (op->opc == INDEX_op_plugin_mem_cb) {
+            n++;
+        } else if (op->opc == INDEX_op_set_label) {
+            g_ptr_array_add(labels, arg_label(op->args[0]));
+        } else {
+            l = plugin_op_branch_label(op);
+            if (l && g_ptr_array_find(labels, l, NULL)) {
+                return -1;
+            }
+        }
+    }
+    return n;
+}
+
+/*
+ * Reserve room in the trace buffers of @insn for the records its
+ * inline memory callbacks queue.  Records of accesses done by helpers
+ * are queued out of line and are not counted, so if @insn calls a
+ * helper that may access memory, or loops, append every record of the
+ * instruction out of line: plugin_mem_buffer_append() drains the
+ * buffer itself before it overflows.
+ */
+static void inject_mem_buffer_reserve(struct qemu_plugin_insn *insn,
+                                      TCGOp *op)
+{
+    GArray *cbs = insn->mem_cbs;
+    int i, n = 0, ops;
+
+    for (i = 0; cbs && i < cbs->len; i++) {
+        n += g_array_index(cbs, struct qemu_plugin_dyn_cb, i).type ==
+             PLUGIN_CB_MEM_BUFFER;
+    }
+    if (n == 0) {
+        return;
+    }
+    ops = insn->mem_helper ? -1 : plugin_insn_mem_ops(op);
+    if (ops == 0) {
+        return;
+    }
+
+    /*
+     * Several registrations may share one buffer, so reserve room for
+     * every buffered registration on each of them.
+     */
+    for (i = 0; i < cbs->len; i++) {
+        struct qemu_plugin_dyn_cb *cb =
+            &g_array_index(cbs, struct qemu_plugin_dyn_cb, i);
+
+        if (cb->type == PLUGIN_CB_MEM_BUFFER) {
+            if (ops < 0) {
+                cb->buffer.use_append = true;
+            } else {
+                gen_mem_buffer_reserve(&cb->buffer, ops * n);
+            }
+        }
+    }
+}
+
 static void inject_cb(struct qemu_plugin_dyn_cb *cb)
 
 {
@@ -258,11 +437,57 @@ static void inject_mem_cb(struct qemu_plugin_dyn_cb *cb,
             inject_cb(cb);
         }
         break;
+    case PLUGIN_CB_MEM_BUFFER:
+        if (rw & cb->buffer.rw) {
+            gen_mem_buffer_cb(&cb->buffer, meminfo, addr);
+        }
+        break;
     default:
         g_assert_not_reached();
     }
 }
 
+/* Return the enum qemu_plugin_tb_exit that @op implements, or -1. */
+static int plugin_tb_exit_of(const TCGOp *op)
+{
+    switch (op->opc) {
+    case INDEX_op_goto_tb:
+        /*
+         * The exit_tb following goto_tb is only reached while the jump
+         * is unlinked; count the edge once, before the goto_tb.
+         */
+        return QEMU_PLUGIN_TB_EXIT_DIRECT0 + op->args[0];
+    case INDEX_op_goto_ptr:
+        return QEMU_PLUGIN_TB_EXIT_INDIRECT;
+    case INDEX_op_exit_tb:
+        /* Only exit_tb(NULL, 0) leaves to an unknown destination. */
+        return op->args[0] == 0 ? QEMU_PLUGIN_TB_EXIT_INDIRECT : -1;
+    default:
+        return -1;
+    }
+}
+
+static void inject_exit_cbs(struct qemu_plugin_tb *plugin_tb, TCGOp *op)
+{
+    int exit = plugin_tb_exit_of(op);
+    const GArray *cbs;
+    int i, n;
+
+    if (exit < 0) {
+        return;
+    }
+    cbs = plugin_tb->exit_cbs[exit];
+    if (!cbs || !cbs->len) {
+        return;
+    }
+
+    tcg_ctx->emit_before_op = op;
+    for (i = 0, n = cbs->len; i < n; i++) {
+        inject_cb(&g_array_index(cbs, struct qemu_plugin_dyn_cb, i));
+    }
+    tcg_ctx->emit_before_op = NULL;
+}
+
 static void plugin_gen_inject(struct qemu_plugin_tb *plugin_tb)
 {
     TCGOp *op, *next;
@@ -339,6 +564,7 @@ static void plugin_gen_inject(struct qemu_plugin_tb *plugin_tb)
                     inject_cb(
                         &g_array_index(cbs, struct qemu_plugin_dyn_cb, i));
                 }
+                inject_mem_buffer_reserve(insn, op);
                 break;
 
             default:
@@ -377,6 +603,12 @@ static void plugin_gen_inject(struct qemu_plugin_tb *plugin_tb)
             break;
         }
 
+        case INDEX_op_goto_tb:
+        case INDEX_op_goto_ptr:
+        case INDEX_op_exit_tb:
+            inject_exit_cbs(plugin_tb, op);
+            break;
+
         default:
             /* plugins don't care about any other ops */
             break;
@@ -402,6 +634,11 @@ bool plugin_gen_tb_start(CPUState *cpu, const DisasContextBase *db)
         if (ptb->cbs) {
             g_array_set_size(ptb->cbs, 0);
         }
+        for (int i = 0; i < ARRAY_SIZE(ptb->exit_cbs); i++) {
+            if (ptb->exit_cbs[i]) {
+                g_array_set_size(ptb->exit_cbs[i], 0);
+            }
+        }
         ptb->n = 0;
         ptb->mem_helper = false;
     } else {
@@ -466,11 +703,21 @@ void plugin_gen_insn_end(void)
 void plugin_gen_tb_end(CPUState *cpu, size_t num_insns)
 {
     struct qemu_plugin_tb *ptb = tcg_ctx->plugin_tb;
+    TCGOp *op;
 
     /* translator may have removed instructions, update final count */
     g_assert(num_insns <= ptb->n);
     ptb->n = num_insns;
 
+    /* find the ways out of the TB, for qemu_plugin_tb_has_exit */
+    ptb->exits = 0;
+    QTAILQ_FOREACH(op, &tcg_ctx->ops, link) {
+        int exit = plugin_tb_exit_of(op);
+        if (exit >= 0) {
+            ptb->exits |= 1u << exit;
+        }
+    }
+
     /* collect instrumentation requests */
     qemu_plugin_tb_trans_cb(cpu, ptb);
 
@@ -34,7 +34,10 @@ struct TBContext {
 
     /* statistics */
     unsigned tb_flush_count;
+    unsigned tb_evict_count;
     unsigned tb_phys_invalidate_count;
+    unsigned tb_gen_count;
+    unsigned tb_gen_discard_count;
 };
 
 extern TBContext tb_ctx;
@@ -21,13 +21,35 @@
  * no need for qatomic_rcu_read() and pc is always consistent with a
  * non-NULL value of 'tb'.  Strictly speaking pc is only needed for
  * CF_PCREL, but it's used always for simplicity.
+ *
+ * The cache is two-way set associative: 'victim' holds the entry most
+ * recently displaced from 'array' at the same index, so that indirect
+ * branches alternating between two colliding targets do not fall back
+ * to the QHT on every lookup.  Both ways are invalidated together.
  */
 typedef struct CPUJumpCache {
     struct rcu_head rcu;
     struct {
         TranslationBlock *tb;
         vaddr pc;
-    } array[TB_JMP_CACHE_SIZE];
+    } array[TB_JMP_CACHE_SIZE], victim[TB_JMP_CACHE_SIZE];
 } CPUJumpCache;
 
+/*
+ * Install @tb for @pc in way 0 at @hash, demoting the previous
+ * occupant to the victim way.
+ */
+static inline void tb_jmp_cache_insert(CPUJumpCache *jc, uint32_t hash,
+                                       vaddr pc, TranslationBlock *tb)
+{
+    TranslationBlock *old = qatomic_read(&jc->array[hash].tb);
+
+    if (old) {
+        jc->victim[hash].pc = jc->array[hash].pc;
+        qatomic_set(&jc->victim[hash].tb, old);
+    }
+    jc->array[hash].pc = pc;
+    qatomic_set(&jc->array[hash].tb, tb);
+}
+
 #endif /* ACCEL_TCG_TB_JMP_CACHE_H */
@@ -292,6 +292,7 @@ struct page_entry {
  * struct page_collection - tracks a set of pages (i.e. &struct page_entry's)
  * @tree:   Binary search tree (BST) of the pages, with key == page index
  * @max:    Pointer to the page in @tree with the highest page index
+ * @single: The only locked page, if @tree is not needed (see below)
  *
  * To avoid deadlock we lock pages in ascending order of page index.
  * When operating on a set of pages, we need to keep track of them so that
@@ -303,6 +304,10 @@ struct page_entry {
  * the tree and its index is higher than @max's, then we can lock it
  * without breaking the locking order rule.
  *
+ * The common case for self-modifying code is a store that hits a single page
+ * whose TBs do not span into any other page. There is then only one lock to
+ * take, so we skip the tree and record the page in @single instead.
+ *
  * Note on naming: 'struct page_set' would be shorter, but we already have a few
  * page_set_*() helpers, so page_collection is used instead to avoid confusion.
  *
@@ -311,6 +316,7 @@ struct page_entry {
 struct page_collection {
     QTree *tree;
     struct page_entry *max;
+    PageDesc *single;
 };
 
 typedef int PageForEachNext;
@@ -597,6 +603,32 @@ static gint tb_page_addr_cmp(gconstpointer ap, gconstpointer bp, gpointer udata)
     return 1;
 }
 
+/*
+ * Lock page @index, if all of its TBs are contained within it.
+ * Returns the locked page, or NULL if the page has no descriptor or
+ * some TB also needs the lock of another page.
+ */
+static PageDesc *page_lock_single(tb_page_addr_t index)
+{
+    PageDesc *pd = page_find(index);
+    TranslationBlock *tb;
+    PageForEachNext n;
+
+    if (pd == NULL) {
+        return NULL;
+    }
+    page_lock(pd);
+    PAGE_FOR_EACH_TB(unused, unused, pd, tb, n) {
+        if (tb_page_addr0(tb) >> TARGET_PAGE_BITS != index ||
+            (tb_page_addr1(tb) != -1 &&
+             tb_page_addr1(tb) >> TARGET_PAGE_BITS != index)) {
+            page_unlock(pd);
+            return NULL;
+        }
+    }
+    return pd;
+}
+
 /*
  * Lock a range of pages ([@start,@last]) as well as the pages of all
  * intersecting TBs.
@@ -613,11 +645,21 @@ static struct page_collection *page_collection_lock(tb_page_addr_t start,
     last >>= TARGET_PAGE_BITS;
     g_assert(start <= last);
 
-    set->tree = q_tree_new_full(tb_page_addr_cmp, NULL, NULL,
-                                page_entry_destroy);
+    set->tree = NULL;
     set->max = NULL;
+    set->single = NULL;
     assert_no_pages_locked();
 
+    if (start == last) {
+        set->single = page_lock_single(start);
+        if (set->single) {
+            return set;
+        }
+    }
+
+    set->tree = q_tree_new_full(tb_page_addr_cmp, NULL, NULL,
+                                page_entry_destroy);
+
  retry:
     q_tree_foreach(set->tree, page_entry_lock, NULL);
 
@@ -649,8 +691,12 @@ static struct page_collection *page_collection_lock(tb_page_addr_t start,
 
 static void page_collection_unlock(struct page_collection *set)
 {
-    /* entries are unlocked and freed via page_entry_destroy */
-    q_tree_destroy(set->tree);
+    if (set->single) {
+        page_unlock(set->single);
+    } else {
+        /* entries are unlocked and freed via page_entry_destroy */
+        q_tree_destroy(set->tree);
+    }
     g_free(set);
 }
 
@@ -897,6 +943,9 @@ static void tb_jmp_cache_inval_tb(TranslationBlock *tb)
             if (qatomic_read(&jc->array[h].tb) == tb) {
                 qatomic_set(&jc->array[h].tb, NULL);
             }
+            if (qatomic_read(&jc->victim[h].tb) == tb) {
+                qatomic_set(&jc->victim[h].tb, NULL);
+            }
         }
     }
 }
@@ -906,7 +955,8 @@ static void tb_jmp_cache_inval_tb(TranslationBlock *tb)
  * In !user-mode, if @rm_from_page_list is set, call with the TB's pages'
  * locks held.
  */
-static void do_tb_phys_invalidate(TranslationBlock *tb, bool rm_from_page_list)
+static void do_tb_phys_invalidate(TranslationBlock *tb, bool rm_from_page_list,
+                                  bool inval_jmp_cache)
 {
     uint32_t h;
     tb_page_addr_t phys_pc;
@@ -933,7 +983,9 @@ static void do_tb_phys_invalidate(TranslationBlock *tb, bool rm_from_page_list)
     }
 
     /* remove the TB from the hash list */
-    tb_jmp_cache_inval_tb(tb);
+    if (inval_jmp_cache) {
+        tb_jmp_cache_inval_tb(tb);
+    }
 
     /* suppress this TB from the two jump lists */
     tb_remove_from_jmp_list(tb, 0);
@@ -949,7 +1001,7 @@ static void do_tb_phys_invalidate(TranslationBlock *tb, bool rm_from_page_list)
 static void tb_phys_invalidate__locked(TranslationBlock *tb)
 {
     qemu_thread_jit_write();
-    do_tb_phys_invalidate(tb, true);
+    do_tb_phys_invalidate(tb, true, true);
     qemu_thread_jit_execute();
 }
 
@@ -961,10 +1013,79 @@ void tb_phys_invalidate(TranslationBlock *tb, tb_page_addr_t page_addr)
 {
     if (page_addr == -1 && tb_page_addr0(tb) != -1) {
         tb_lock_pages(tb);
-        do_tb_phys_invalidate(tb, true);
+        do_tb_phys_invalidate(tb, true, true);
         tb_unlock_pages(tb);
     } else {
-        do_tb_phys_invalidate(tb, false);
+        do_tb_phys_invalidate(tb, false, true);
+    }
+}
+
+static gboolean tb_evict_iter(gpointer key, gpointer value, gpointer data)
+{
+    TranslationBlock *tb = value;
+
+    tb_lock_pages(tb);
+    /* The jump caches are flushed wholesale by the caller. */
+    do_tb_phys_invalidate(tb, true, false);
+    tb_unlock_pages(tb);
+    return false;
+}
+
+static void do_tb_reclaim(CPUState *cpu, run_on_cpu_data tb_gen)
+{
+    unsigned tb_flush_count;
+    bool did_evict = false;
+    bool need_flush = false;
+    CPUState *other;
+
+    mmap_lock();
+    tb_flush_count = tb_ctx.tb_flush_count;
+    /* If a flush or eviction already freed space, just retry. */
+    if (tb_flush_count + tb_ctx.tb_evict_count != tb_gen.host_int) {
+        goto done;
+    }
+
+    CPU_FOREACH(other) {
+        tcg_flush_jmp_cache(other);
+    }
+
+    qemu_thread_jit_write();
+    did_evict = tcg_region_evict(tb_evict_iter, NULL);
+    qemu_thread_jit_execute();
+
+    if (did_evict) {
+        qatomic_inc(&tb_ctx.tb_evict_count);
+    } else {
+        need_flush = true;
+    }
+
+done:
+    mmap_unlock();
+    if (did_evict) {
+        qemu_plugin_flush_cb();
+    } else if (need_flush) {
+        /* Nothing could be evicted: drop everything. */
+        do_tb_flush(cpu, RUN_ON_CPU_HOST_INT(tb_flush_count));
+    }
+}
+
+/*
+ * Make room in the code buffer after a failed TB allocation.  With more than
+ * one region, this evicts the oldest full region, keeping the translations
+ * held in the others; otherwise it is equivalent to tb_flush().
+ */
+void tb_reclaim(CPUState *cpu)
+{
+    if (tcg_enabled()) {
+        unsigned tb_gen = qatomic_read(&tb_ctx.tb_flush_count) +
+                          qatomic_read(&tb_ctx.tb_evict_count);
+
+        if (cpu_in_serial_context(cpu)) {
+            do_tb_reclaim(cpu, RUN_ON_CPU_HOST_INT(tb_gen));
+        } else {
+            async_safe_run_on_cpu(cpu, do_tb_reclaim,
+                                  RUN_ON_CPU_HOST_INT(tb_gen));
+        }
     }
 }
 
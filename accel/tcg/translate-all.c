@@ -319,8 +319,8 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
     assert_no_pages_locked();
     tb = tcg_tb_alloc(tcg_ctx);
     if (unlikely(!tb)) {
-        /* flush must be done */
-        tb_flush(cpu);
+        /* evict old translations, or flush if that is not possible */
+        tb_reclaim(cpu);
         mmap_unlock();
         /* Make the execution loop process the flush as soon as possible.  */
         cpu->exception_index = EXCP_INTERRUPT;
@@ -536,6 +536,7 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
      * lookup itself using host PC.
      */
     tcg_tb_insert(tb);
+    qatomic_inc(&tb_ctx.tb_gen_count);
 
     /*
      * If the TB is not associated with a physical RAM page then it must be
@@ -570,6 +571,7 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
         orig_aligned -= ROUND_UP(sizeof(*tb), qemu_icache_linesize);
         qatomic_set(&tcg_ctx->code_gen_ptr, (void *)orig_aligned);
         tcg_tb_remove(tb);
+        qatomic_inc(&tb_ctx.tb_gen_discard_count);
         return existing_tb;
     }
     return tb;
@@ -674,5 +676,6 @@ void tcg_flush_jmp_cache(CPUState *cpu)
 
     for (int i = 0; i < TB_JMP_CACHE_SIZE; i++) {
         qatomic_set(&jc->array[i].tb, NULL);
+        qatomic_set(&jc->victim[i].tb, NULL);
     }
 }
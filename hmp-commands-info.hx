@@ -270,6 +270,25 @@ SRST
     Show dynamic compiler opcode counters
 ERST
 
+#if defined(CONFIG_TCG)
+    {
+        .name       = "tcg-profile",
+        .args_type  = "folded:-f,stop:-s",
+        .params     = "[-f] [-s]",
+        .help       = "show sampled TCG execution profile "
+                      "(-f: in folded stack format for flamegraph.pl; "
+                      "-s: then stop sampling and discard the samples)",
+    },
+#endif
+
+SRST
+  ``info tcg-profile [-f] [-s]``
+    Show the sampled TCG execution profile.  Sampling starts the first
+    time this is used.  With ``-f``, print it in the folded stack format
+    of ``stackcollapse-perf.pl``.  With ``-s``, stop sampling afterwards
+    and discard the samples.
+ERST
+
     {
         .name       = "sync-profile",
         .args_type  = "mean:-m,no_coalesce:-n,max:i?",
@@ -229,6 +229,35 @@ void tlb_flush_range_by_mmuidx_all_cpus_synced(CPUState *cpu,
                                                vaddr len,
                                                uint16_t idxmap,
                                                unsigned bits);
+
+/**
+ * tlb_walk_cache_lookup:
+ * @cpu: CPU performing the page table walk
+ * @addr: physical address of the page table descriptor
+ * @pval: filled in with the cached descriptor on success
+ *
+ * Look up a page table descriptor recorded by tlb_walk_cache_insert,
+ * so that a walk on a tlb miss need not reload the upper levels of
+ * the page table.  Returns true on a hit.
+ *
+ * Must be called from the thread of @cpu.
+ */
+bool tlb_walk_cache_lookup(CPUState *cpu, hwaddr addr, uint64_t *pval);
+
+/**
+ * tlb_walk_cache_insert:
+ * @cpu: CPU performing the page table walk
+ * @addr: physical address of the page table descriptor
+ * @val: the descriptor loaded from @addr
+ *
+ * Record a page table descriptor for tlb_walk_cache_lookup.  The cache
+ * is discarded by every tlb flush of @cpu, so only descriptors that the
+ * architecture allows to be cached until the next tlb invalidation
+ * (typically valid non-leaf entries) may be recorded.
+ *
+ * Must be called from the thread of @cpu.
+ */
+void tlb_walk_cache_insert(CPUState *cpu, hwaddr addr, uint64_t val);
 #else
 static inline void tlb_flush_page(CPUState *cpu, vaddr addr)
 {
@@ -282,5 +311,14 @@ static inline void tlb_flush_range_by_mmuidx_all_cpus_synced(CPUState *cpu,
                                                              unsigned bits)
 {
 }
+static inline bool tlb_walk_cache_lookup(CPUState *cpu, hwaddr addr,
+                                         uint64_t *pval)
+{
+    return false;
+}
+static inline void tlb_walk_cache_insert(CPUState *cpu, hwaddr addr,
+                                         uint64_t val)
+{
+}
 #endif /* CONFIG_TCG && !CONFIG_USER_ONLY */
 #endif /* CPUTLB_H */
@@ -201,6 +201,12 @@ struct CPUClass {
 /* Use a fully associative victim tlb of 8 entries. */
 #define CPU_VTLB_SIZE 8
 
+/* Remember the 4 most recently filled large pages of each mmu_idx. */
+#define CPU_TLB_LARGE_SIZE 4
+
+/* Remember up to 64 filled tlb entries, for flushing a sparse tlb. */
+#define CPU_TLB_FILL_LOG_SIZE 64
+
 /*
  * The full TLB entry, which is not accessed by generated TCG code,
  * so the layout is not as critical as that of CPUTLBEntry. This is
@@ -233,6 +239,18 @@ struct CPUTLBEntryFull {
     /* @lg_page_size contains the log2 of the page size. */
     uint8_t lg_page_size;
 
+    /*
+     * @lg_map_size, if larger than TARGET_PAGE_BITS, is the log2 of the
+     * size of the aligned virtual region around the page that the target
+     * guarantees to map linearly onto @phys_addr, with the same @attrs,
+     * @prot and flags for every page.  The core tlb may then fill the
+     * other pages of the region without calling tlb_fill.  Unlike
+     * @lg_page_size, which may be larger than the mapping, e.g. when
+     * merging two stages of translation, this must be exact; leave it
+     * 0 when unsure.
+     */
+    uint8_t lg_map_size;
+
     /* Additional tlb flags requested by tlb_fill. */
     uint8_t tlb_fill_flags;
 
@@ -288,8 +306,44 @@ typedef struct CPUTLBDesc {
     CPUTLBEntry vtable[CPU_VTLB_SIZE];
     CPUTLBEntryFull vfulltlb[CPU_VTLB_SIZE];
     CPUTLBEntryFull *fulltlb;
+    /*
+     * Indexes of the fast table entries filled since the last flush.
+     * If more than CPU_TLB_FILL_LOG_SIZE entries have been filled,
+     * n_fill_log is CPU_TLB_FILL_LOG_SIZE + 1 and the whole table
+     * must be cleared.
+     */
+    size_t n_fill_log;
+    uint32_t fill_log[CPU_TLB_FILL_LOG_SIZE];
+    /*
+     * Linear mappings recently filled by the target, see lg_map_size
+     * in CPUTLBEntryFull, so that their other pages can be filled
+     * without another page table walk.  large_addr[i] is the aligned
+     * virtual address of the mapping, or -1 if the slot is unused;
+     * large_full[i].phys_addr is the matching physical address.
+     */
+    size_t large_next;
+    vaddr large_addr[CPU_TLB_LARGE_SIZE];
+    CPUTLBEntryFull large_full[CPU_TLB_LARGE_SIZE];
 } CPUTLBDesc;
 
+/* Cache up to 16 page table descriptors, see tlb_walk_cache_lookup. */
+#define CPU_TLB_WALK_CACHE_SIZE 16
+
+typedef struct CPUTLBWalkEntry {
+    hwaddr addr;
+    uint64_t val;
+} CPUTLBWalkEntry;
+
+/* Queue up to 8 range flushes requested by other cpus. */
+#define CPU_TLB_PENDING_SIZE 8
+
+typedef struct TLBFlushRangeData {
+    vaddr addr;
+    vaddr len;
+    uint16_t idxmap;
+    uint16_t bits;
+} TLBFlushRangeData;
+
 /*
  * Data elements that are shared between all MMU modes.
  */
@@ -302,6 +356,23 @@ typedef struct CPUTLBCommon {
      * Protected by tlb_c.lock.
      */
     uint16_t dirty;
+    /*
+     * Range flushes requested by other cpus and not yet applied,
+     * merged where they overlap.  Once the queue overflows, the
+     * affected mmu_idx are flushed entirely via pending_full instead.
+     * Protected by tlb_c.lock.
+     */
+    bool pending_scheduled;
+    uint16_t pending_full;
+    unsigned n_pending;
+    TLBFlushRangeData pending[CPU_TLB_PENDING_SIZE];
+    /*
+     * Page table descriptors recorded by the target's page table walker,
+     * direct mapped by address.  Bit N of walk_valid is set if walk[N]
+     * is valid; all are discarded on any flush.  Only accessed by the cpu.
+     */
+    uint32_t walk_valid;
+    CPUTLBWalkEntry walk[CPU_TLB_WALK_CACHE_SIZE];
     /*
      * Statistics.  These are not lock protected, but are read and
      * written atomically.  This allows the monitor to print a snapshot
@@ -310,6 +381,7 @@ typedef struct CPUTLBCommon {
     size_t full_flush_count;
     size_t part_flush_count;
     size_t elide_flush_count;
+    size_t merge_flush_count;
 } CPUTLBCommon;
 
 /*
@@ -506,6 +578,10 @@ struct CPUState {
 
     struct CPUJumpCache *tb_jmp_cache;
 
+    /* Sampled by the TCG profiler; see TCGProfState. */
+    int tcg_prof_state;
+    const TranslationBlock *tcg_prof_tb;
+
     GArray *gdb_regs;
     int gdb_num_regs;
     int gdb_num_g_regs;
@@ -72,6 +72,7 @@ enum plugin_dyn_cb_type {
     PLUGIN_CB_MEM_REGULAR,
     PLUGIN_CB_INLINE_ADD_U64,
     PLUGIN_CB_INLINE_STORE_U64,
+    PLUGIN_CB_MEM_BUFFER,
 };
 
 struct qemu_plugin_regular_cb {
@@ -96,6 +97,26 @@ struct qemu_plugin_conditional_cb {
     uint64_t imm;
 };
 
+struct qemu_plugin_buffer_cb {
+    struct qemu_plugin_mem_buffer *buf;
+    qemu_plugin_vcpu_udata_cb_t drain;
+    TCGHelperInfo *info;
+    /* appends one record, draining the buffer when it is full */
+    void (*append)(unsigned int vcpu_index, qemu_plugin_meminfo_t info,
+                   uint64_t vaddr, uint64_t insn_vaddr, void *buf);
+    TCGHelperInfo *append_info;
+    uint64_t insn_vaddr;
+    enum qemu_plugin_mem_rw rw;
+    /*
+     * Set at translation time if the instruction may queue more records
+     * than the buffer holds, loops over its memory operations, or calls
+     * helpers that may access memory, so that no room can be reserved for
+     * them at the start of the instruction: append them with @append
+     * instead.
+     */
+    bool use_append;
+};
+
 /*
  * A dynamic callback has an insertion point that is determined at run-time.
  * Usually the insertion point is somewhere in the code cache; think for
@@ -107,6 +128,7 @@ struct qemu_plugin_dyn_cb {
         struct qemu_plugin_regular_cb regular;
         struct qemu_plugin_conditional_cb cond;
         struct qemu_plugin_inline_cb inline_insn;
+        struct qemu_plugin_buffer_cb buffer;
     };
 };
 
@@ -122,12 +144,34 @@ struct qemu_plugin_insn {
     bool mem_helper;
 };
 
-/* A scoreboard is an array of values, indexed by vcpu_index */
+/*
+ * A scoreboard is an array of values, indexed by vcpu_index.  Entries are
+ * padded to a whole number of cache lines so that vCPUs updating their own
+ * entry do not false-share.  @data is replaced, never resized in place, when
+ * more vCPUs appear; the old arrays are kept in @retired until the scoreboard
+ * is freed, as plugin-owned threads may still be reading them.
+ */
 struct qemu_plugin_scoreboard {
-    GArray *data;
+    char *data;
+    size_t element_size;
+    GSList *retired;
     QLIST_ENTRY(qemu_plugin_scoreboard) entry;
 };
 
+/*
+ * A memory trace buffer.  Each scoreboard entry holds the number of
+ * records queued for that vCPU, followed by n_records records.
+ */
+struct qemu_plugin_mem_buffer {
+    struct qemu_plugin_scoreboard *score;
+    size_t n_records;
+    qemu_plugin_vcpu_mem_buf_cb_t cb;
+    void *userdata;
+};
+
+#define PLUGIN_MEM_BUFFER_HDR  sizeof(uint64_t)
+#define PLUGIN_MEM_BUFFER_MIN  64
+
 /* Internal context for this TranslationBlock */
 struct qemu_plugin_tb {
     GPtrArray *insns;
@@ -137,6 +181,10 @@ struct qemu_plugin_tb {
     bool mem_helper;
 
     GArray *cbs;
+
+    /* mask of the enum qemu_plugin_tb_exit found in the TB */
+    unsigned exits;
+    GArray *exit_cbs[QEMU_PLUGIN_TB_EXIT_INDIRECT + 1];
 };
 
 /**
@@ -65,11 +65,18 @@ typedef uint64_t qemu_plugin_id_t;
  *
  * version 4:
  * - added qemu_plugin_read_memory_vaddr
+ *
+ * version 5:
+ * - added buffered memory tracing: qemu_plugin_mem_buffer_new,
+ *   qemu_plugin_mem_buffer_free, qemu_plugin_mem_buffer_flush and
+ *   qemu_plugin_register_vcpu_mem_buffer
+ * - added TB exit counters: qemu_plugin_tb_has_exit and
+ *   qemu_plugin_register_vcpu_tb_exit_inline_per_vcpu
  */
 
 extern QEMU_PLUGIN_EXPORT int qemu_plugin_version;
 
-#define QEMU_PLUGIN_VERSION 4
+#define QEMU_PLUGIN_VERSION 5
 
 /**
  * struct qemu_info_t - system information for plugins
@@ -409,6 +416,57 @@ void qemu_plugin_register_vcpu_tb_exec_inline_per_vcpu(
     qemu_plugin_u64 entry,
     uint64_t imm);
 
+/**
+ * enum qemu_plugin_tb_exit - the ways control can leave a TB
+ *
+ * @QEMU_PLUGIN_TB_EXIT_DIRECT0: first exit to a fixed destination
+ * @QEMU_PLUGIN_TB_EXIT_DIRECT1: second exit to a fixed destination
+ * @QEMU_PLUGIN_TB_EXIT_INDIRECT: exit to a destination computed at run time
+ *
+ * Each direct exit of a given TB always leads to the same guest address,
+ * so (TB, direct exit) identifies a control flow edge.  Which of the two
+ * slots is the taken side of a conditional branch is up to the target;
+ * most use DIRECT0 for the fall-through path.
+ */
+enum qemu_plugin_tb_exit {
+    QEMU_PLUGIN_TB_EXIT_DIRECT0,
+    QEMU_PLUGIN_TB_EXIT_DIRECT1,
+    QEMU_PLUGIN_TB_EXIT_INDIRECT,
+};
+
+/**
+ * qemu_plugin_tb_has_exit() - query whether a TB can leave through an exit
+ * @tb: opaque handle to TB passed to callback
+ * @exit: the exit to query
+ *
+ * Returns: true if @tb contains @exit.  Iterating over all values of
+ * &enum qemu_plugin_tb_exit gives the outgoing edges of the block.
+ */
+QEMU_PLUGIN_API
+bool qemu_plugin_tb_has_exit(const struct qemu_plugin_tb *tb,
+                             enum qemu_plugin_tb_exit exit);
+
+/**
+ * qemu_plugin_register_vcpu_tb_exit_inline_per_vcpu() - exit inline op
+ * @tb: the opaque qemu_plugin_tb handle for the translation
+ * @exit: which exit of the TB to instrument
+ * @op: the type of qemu_plugin_op (e.g. ADD_U64)
+ * @entry: entry to run op
+ * @imm: the op data (e.g. 1)
+ *
+ * Insert an inline op on a given scoreboard entry, run every time
+ * control leaves @tb through @exit.  This makes it possible to count
+ * edges without a callback per block.  Blocks left through an exception
+ * or interrupt do not run any exit op.
+ */
+QEMU_PLUGIN_API
+void qemu_plugin_register_vcpu_tb_exit_inline_per_vcpu(
+    struct qemu_plugin_tb *tb,
+    enum qemu_plugin_tb_exit exit,
+    enum qemu_plugin_op op,
+    qemu_plugin_u64 entry,
+    uint64_t imm);
+
 /**
  * qemu_plugin_register_vcpu_insn_exec_cb() - register insn execution cb
  * @insn: the opaque qemu_plugin_insn handle for an instruction
@@ -701,6 +759,101 @@ void qemu_plugin_register_vcpu_mem_inline_per_vcpu(
     qemu_plugin_u64 entry,
     uint64_t imm);
 
+/**
+ * struct qemu_plugin_mem_record - one access in a memory trace buffer
+ * @vaddr: virtual address of the access
+ * @insn_vaddr: virtual address of the instruction making the access
+ * @info: opaque memory transaction handle, as for qemu_plugin_vcpu_mem_cb_t
+ * @reserved: padding, always zero
+ *
+ * Only the fields of @info that describe the access (size, sign,
+ * endianness, store) may be queried; the value and hwaddr are not
+ * available once the access has completed.
+ */
+typedef struct {
+    uint64_t vaddr;
+    uint64_t insn_vaddr;
+    qemu_plugin_meminfo_t info;
+    uint32_t reserved;
+} qemu_plugin_mem_record;
+
+/** struct qemu_plugin_mem_buffer - Opaque handle for a memory trace buffer */
+struct qemu_plugin_mem_buffer;
+
+/**
+ * typedef qemu_plugin_vcpu_mem_buf_cb_t - memory trace buffer callback
+ * @vcpu_index: the vCPU whose buffer is being drained
+ * @records: the buffered accesses, oldest first
+ * @n: number of entries in @records
+ * @userdata: user data passed to qemu_plugin_mem_buffer_new()
+ *
+ * @records is only valid for the duration of the callback.
+ */
+typedef void (*qemu_plugin_vcpu_mem_buf_cb_t)(
+    unsigned int vcpu_index, const qemu_plugin_mem_record *records,
+    size_t n, void *userdata);
+
+/**
+ * qemu_plugin_mem_buffer_new() - allocate a memory trace buffer
+ * @n_records: capacity of each vCPU's buffer
+ * @cb: callback to drain a full buffer
+ * @userdata: passed to @cb
+ *
+ * Each vCPU gets its own buffer of @n_records entries (at least 64
+ * are always allocated).  Accesses registered with
+ * qemu_plugin_register_vcpu_mem_buffer() are appended inline by the
+ * generated code, and @cb is only called once the vCPU's buffer is
+ * nearly full.  This is much cheaper than a callback per access.
+ * Instructions that may access memory more times than the buffer holds,
+ * or an unknown number of times, append their records with a helper
+ * call instead, which is slower but still drains the buffer as needed.
+ * Records still queued when the plugin is done must be drained with
+ * qemu_plugin_mem_buffer_flush().
+ *
+ * Returns a handle to be freed with qemu_plugin_mem_buffer_free().
+ */
+QEMU_PLUGIN_API
+struct qemu_plugin_mem_buffer *
+qemu_plugin_mem_buffer_new(size_t n_records,
+                           qemu_plugin_vcpu_mem_buf_cb_t cb,
+                           void *userdata);
+
+/**
+ * qemu_plugin_mem_buffer_free() - free a memory trace buffer
+ * @buf: buffer to free
+ *
+ * Undrained records are discarded.
+ */
+QEMU_PLUGIN_API
+void qemu_plugin_mem_buffer_free(struct qemu_plugin_mem_buffer *buf);
+
+/**
+ * qemu_plugin_mem_buffer_flush() - drain a vCPU's memory trace buffer
+ * @buf: buffer to drain
+ * @vcpu_index: vCPU whose records to drain
+ *
+ * Calls the buffer's callback for any records not yet delivered.  This
+ * must be called either from a callback running on @vcpu_index, or
+ * when that vCPU is not running, e.g. from the atexit callback.
+ */
+QEMU_PLUGIN_API
+void qemu_plugin_mem_buffer_flush(struct qemu_plugin_mem_buffer *buf,
+                                  unsigned int vcpu_index);
+
+/**
+ * qemu_plugin_register_vcpu_mem_buffer() - buffer memory accesses
+ * @insn: handle for instruction to instrument
+ * @rw: apply to reads, writes or both
+ * @buf: buffer to append to
+ *
+ * This records every memory access generated by the instruction in
+ * @buf.  See qemu_plugin_mem_buffer_new().
+ */
+QEMU_PLUGIN_API
+void qemu_plugin_register_vcpu_mem_buffer(struct qemu_plugin_insn *insn,
+                                          enum qemu_plugin_mem_rw rw,
+                                          struct qemu_plugin_mem_buffer *buf);
+
 /**
  * qemu_plugin_request_time_control() - request the ability to control time
  *
@@ -938,6 +1091,9 @@ int qemu_plugin_read_register(struct qemu_plugin_register *handle,
  *
  * Returns a pointer to a new scoreboard. It must be freed using
  * qemu_plugin_scoreboard_free.
+ *
+ * Each vCPU's entry is padded to a whole number of cache lines, so vCPUs
+ * updating their own entry never contend with each other.
  */
 QEMU_PLUGIN_API
 struct qemu_plugin_scoreboard *qemu_plugin_scoreboard_new(size_t element_size);
@@ -998,6 +1154,11 @@ void qemu_plugin_u64_set(qemu_plugin_u64 entry, unsigned int vcpu_index,
 /**
  * qemu_plugin_u64_sum() - return sum of all vcpu entries in a scoreboard
  * @entry: entry to sum
+ *
+ * This takes no lock and may be called at any time from any thread,
+ * including a thread owned by the plugin that aggregates counters
+ * periodically while the vCPUs run.  Entries still being updated by
+ * running vCPUs may be read slightly stale.
  */
 QEMU_PLUGIN_API
 uint64_t qemu_plugin_u64_sum(qemu_plugin_u64 entry);
@@ -111,6 +111,9 @@ void hmp_info_migrate(Monitor *mon, const QDict *qdict)
                        info->ram->normal_bytes >> 10);
         monitor_printf(mon, "dirty sync count: %" PRIu64 "\n",
                        info->ram->dirty_sync_count);
+        monitor_printf(mon, "dirty sync time: %" PRIu64 " us log, %" PRIu64
+                       " us bitmap\n", info->ram->dirty_sync_log_time,
+                       info->ram->dirty_sync_bitmap_time);
         monitor_printf(mon, "page size: %" PRIu64 " kbytes\n",
                        info->ram->page_size >> 10);
         monitor_printf(mon, "multifd bytes: %" PRIu64 " kbytes\n",
@@ -162,6 +165,20 @@ void hmp_info_migrate(Monitor *mon, const QDict *qdict)
                        info->xbzrle_cache->overflow);
     }
 
+    if (info->has_multifd_channels) {
+        MultiFDChannelStatsList *chan;
+
+        for (chan = info->multifd_channels; chan; chan = chan->next) {
+            monitor_printf(mon, "multifd channel %u: %" PRIu64 " kbytes, %"
+                           PRIu64 " kbytes encoded, rate %0.2f, cpu %"
+                           PRIu64 " us\n", chan->value->id,
+                           chan->value->bytes >> 10,
+                           chan->value->encoded_bytes >> 10,
+                           chan->value->compression_rate,
+                           chan->value->cpu_time);
+        }
+    }
+
     if (info->has_cpu_throttle_percentage) {
         monitor_printf(mon, "cpu throttle percentage: %" PRIu64 "\n",
                        info->cpu_throttle_percentage);
@@ -360,6 +377,11 @@ void hmp_info_migrate_parameters(Monitor *mon, const QDict *qdict)
                                MIGRATION_PARAMETER_DIRECT_IO),
                            params->direct_io ? "on" : "off");
         }
+
+        assert(params->has_postcopy_prefetch_pages);
+        monitor_printf(mon, "%s: %u pages\n",
+            MigrationParameter_str(MIGRATION_PARAMETER_POSTCOPY_PREFETCH_PAGES),
+            params->postcopy_prefetch_pages);
     }
 
     qapi_free_MigrationParameters(params);
@@ -641,6 +663,10 @@ void hmp_migrate_set_parameter(Monitor *mon, const QDict *qdict)
         p->has_direct_io = true;
         visit_type_bool(v, param, &p->direct_io, &err);
         break;
+    case MIGRATION_PARAMETER_POSTCOPY_PREFETCH_PAGES:
+        p->has_postcopy_prefetch_pages = true;
+        visit_type_uint32(v, param, &p->postcopy_prefetch_pages, &err);
+        break;
     default:
         g_assert_not_reached();
     }
@@ -50,6 +50,16 @@ typedef struct {
      * Number of times we have synchronized guest bitmaps.
      */
     Stat64 dirty_sync_count;
+    /*
+     * Microseconds spent in the last synchronization collecting the
+     * dirty log from the accelerator.
+     */
+    Stat64 dirty_sync_log_time;
+    /*
+     * Microseconds spent in the last synchronization merging the dirty
+     * log into the migration bitmap.
+     */
+    Stat64 dirty_sync_bitmap_time;
     /*
      * Number of times zero copy failed to send any page using zero
      * copy.
@@ -512,21 +512,22 @@ static int migrate_send_rp_message(MigrationIncomingState *mis,
     return qemu_fflush(mis->to_src_file);
 }
 
-/* Request one page from the source VM at the given start address.
- *   rb: the RAMBlock to request the page in
+/* Request pages from the source VM at the given start address.
+ *   rb: the RAMBlock to request the pages in
  *   Start: Address offset within the RB
  *   Len: Length in bytes required - must be a multiple of pagesize
  */
-int migrate_send_rp_message_req_pages(MigrationIncomingState *mis,
-                                      RAMBlock *rb, ram_addr_t start)
+int migrate_send_rp_message_req_range(MigrationIncomingState *mis,
+                                      RAMBlock *rb, ram_addr_t start,
+                                      size_t len)
 {
     uint8_t bufc[12 + 1 + 255]; /* start (8), len (4), rbname up to 256 */
     size_t msglen = 12; /* start + len */
-    size_t len = qemu_ram_pagesize(rb);
     enum mig_rp_message_type msg_type;
     const char *rbname;
     int rbname_len;
 
+    assert(len <= UINT32_MAX);
     *(uint64_t *)bufc = cpu_to_be64((uint64_t)start);
     *(uint32_t *)(bufc + 8) = cpu_to_be32((uint32_t)len);
 
@@ -554,6 +555,14 @@ int migrate_send_rp_message_req_pages(MigrationIncomingState *mis,
     return migrate_send_rp_message(mis, msg_type, msglen, bufc);
 }
 
+/* Request one host page of @rb from the source VM */
+int migrate_send_rp_message_req_pages(MigrationIncomingState *mis,
+                                      RAMBlock *rb, ram_addr_t start)
+{
+    return migrate_send_rp_message_req_range(mis, rb, start,
+                                             qemu_ram_pagesize(rb));
+}
+
 int migrate_send_rp_req_pages(MigrationIncomingState *mis,
                               RAMBlock *rb, ram_addr_t start, uint64_t haddr)
 {
@@ -1256,6 +1265,10 @@ static void populate_ram_info(MigrationInfo *info, MigrationState *s)
     info->ram->mbps = s->mbps;
     info->ram->dirty_sync_count =
         stat64_get(&mig_stats.dirty_sync_count);
+    info->ram->dirty_sync_log_time =
+        stat64_get(&mig_stats.dirty_sync_log_time);
+    info->ram->dirty_sync_bitmap_time =
+        stat64_get(&mig_stats.dirty_sync_bitmap_time);
     info->ram->dirty_sync_missed_zero_copy =
         stat64_get(&mig_stats.dirty_sync_missed_zero_copy);
     info->ram->postcopy_requests =
@@ -1297,6 +1310,11 @@ static void populate_ram_info(MigrationInfo *info, MigrationState *s)
         info->has_dirty_limit_ring_full_time = true;
         info->dirty_limit_ring_full_time = dirtylimit_ring_full_time();
     }
+
+    if (migrate_multifd()) {
+        info->multifd_channels = multifd_send_channel_stats();
+        info->has_multifd_channels = info->multifd_channels != NULL;
+    }
 }
 
 static void fill_source_migration_info(MigrationInfo *info)
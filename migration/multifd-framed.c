@@ -0,0 +1,229 @@
+/*
+ * Multifd framed packets, shared by methods encoding pages one by one
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/bswap.h"
+#include "exec/ramblock.h"
+#include "qapi/error.h"
+#include "migration.h"
+#include "multifd.h"
+
+typedef struct {
+    const MultiFDFramedOps *ops;
+    /* state of the method */
+    void *opaque;
+    /* copy of the page being encoded, as it may change under our feet */
+    uint8_t *page;
+    /* encoded packet */
+    uint8_t *buf;
+    uint32_t buf_len;
+} MultiFDFramed;
+
+static MultiFDFramed *multifd_framed_new(const MultiFDFramedOps *ops,
+                                         void *opaque, bool send)
+{
+    MultiFDFramed *f = g_new0(MultiFDFramed, 1);
+    uint32_t page_size = multifd_ram_page_size();
+
+    f->ops = ops;
+    f->opaque = opaque;
+    /* a payload is never larger than a page */
+    f->buf_len = multifd_ram_page_count() *
+                 (MULTIFD_FRAME_HDR_SIZE + page_size);
+    f->buf = g_try_malloc(f->buf_len);
+    if (send) {
+        f->page = g_try_malloc(page_size);
+    }
+    if (!f->buf || (send && !f->page)) {
+        g_free(f->buf);
+        g_free(f->page);
+        g_free(f);
+        return NULL;
+    }
+    return f;
+}
+
+static void *multifd_framed_free(MultiFDFramed *f)
+{
+    void *opaque;
+
+    if (!f) {
+        return NULL;
+    }
+    opaque = f->opaque;
+    g_free(f->buf);
+    g_free(f->page);
+    g_free(f);
+    return opaque;
+}
+
+/* Multifd framed encoding */
+
+int multifd_framed_send_setup(MultiFDSendParams *p,
+                              const MultiFDFramedOps *ops, void *opaque,
+                              Error **errp)
+{
+    MultiFDFramed *f = multifd_framed_new(ops, opaque, true);
+
+    if (!f) {
+        error_setg(errp, "multifd %u: out of memory for %s buffers",
+                   p->id, ops->name);
+        return -1;
+    }
+    p->compress_data = f;
+
+    /* Needs 2 IOVs, one for packet header and one for encoded data */
+    p->iov = g_new0(struct iovec, 2);
+
+    return 0;
+}
+
+/* Returns the state of the method, or NULL if setup failed */
+void *multifd_framed_send_cleanup(MultiFDSendParams *p)
+{
+    void *opaque = multifd_framed_free(p->compress_data);
+
+    p->compress_data = NULL;
+    g_free(p->iov);
+    p->iov = NULL;
+    return opaque;
+}
+
+int multifd_framed_send_prepare(MultiFDSendParams *p, Error **errp)
+{
+    MultiFDPages_t *pages = &p->data->u.ram;
+    MultiFDFramed *f = p->compress_data;
+    const MultiFDFramedOps *ops = f->ops;
+    uint32_t page_size = multifd_ram_page_size();
+    uint32_t out_size = 0;
+    bool has_normal = multifd_send_prepare_common(p);
+    uint32_t i;
+
+    if (ops->zero_page) {
+        for (i = pages->normal_num; i < pages->num; i++) {
+            ops->zero_page(f->opaque, p, i);
+        }
+    }
+
+    if (!has_normal) {
+        goto out;
+    }
+
+    for (i = 0; i < pages->normal_num; i++) {
+        uint8_t *out = f->buf + out_size;
+        uint32_t hdr, len;
+
+        memcpy(f->page, pages->block->host + pages->offset[i], page_size);
+        hdr = ops->encode(f->opaque, p, i, f->page,
+                          out + MULTIFD_FRAME_HDR_SIZE, &len);
+        assert(len <= page_size);
+        stl_be_p(out, hdr);
+        out_size += MULTIFD_FRAME_HDR_SIZE + len;
+    }
+    p->iov[p->iovs_num].iov_base = f->buf;
+    p->iov[p->iovs_num].iov_len = out_size;
+    p->iovs_num++;
+    p->next_packet_size = out_size;
+
+out:
+    p->flags |= ops->flag;
+    multifd_send_fill_packet(p);
+    return 0;
+}
+
+/* Multifd framed decoding */
+
+int multifd_framed_recv_setup(MultiFDRecvParams *p,
+                              const MultiFDFramedOps *ops, void *opaque,
+                              Error **errp)
+{
+    MultiFDFramed *f = multifd_framed_new(ops, opaque, false);
+
+    if (!f) {
+        error_setg(errp, "multifd %u: out of memory for %s buffer",
+                   p->id, ops->name);
+        return -1;
+    }
+    p->compress_data = f;
+    return 0;
+}
+
+/* Returns the state of the method, or NULL if setup failed */
+void *multifd_framed_recv_cleanup(MultiFDRecvParams *p)
+{
+    void *opaque = multifd_framed_free(p->compress_data);
+
+    p->compress_data = NULL;
+    return opaque;
+}
+
+int multifd_framed_recv(MultiFDRecvParams *p, Error **errp)
+{
+    MultiFDFramed *f = p->compress_data;
+    const MultiFDFramedOps *ops = f->ops;
+    uint32_t in_size = p->next_packet_size;
+    uint32_t page_size = multifd_ram_page_size();
+    uint32_t flags = p->flags & MULTIFD_FLAG_COMPRESSION_MASK;
+    uint32_t pos = 0;
+    int ret;
+    int i;
+
+    if (flags != ops->flag) {
+        error_setg(errp, "multifd %u: flags received %x flags expected %x",
+                   p->id, flags, ops->flag);
+        return -1;
+    }
+
+    multifd_recv_zero_page_process(p);
+
+    if (!p->normal_num) {
+        assert(in_size == 0);
+        return 0;
+    }
+
+    if (in_size > f->buf_len) {
+        error_setg(errp, "multifd %u: packet size %u larger than %u",
+                   p->id, in_size, f->buf_len);
+        return -1;
+    }
+
+    ret = qio_channel_read_all(p->c, (void *)f->buf, in_size, errp);
+    if (ret != 0) {
+        return ret;
+    }
+
+    for (i = 0; i < p->normal_num; i++) {
+        uint32_t hdr, len;
+
+        if (in_size - pos < MULTIFD_FRAME_HDR_SIZE) {
+            goto truncated;
+        }
+        hdr = ldl_be_p(f->buf + pos);
+        pos += MULTIFD_FRAME_HDR_SIZE;
+        len = ops->payload_len(hdr);
+        if (len > page_size || in_size - pos < len) {
+            goto truncated;
+        }
+
+        ramblock_recv_bitmap_set_offset(p->block, p->normal[i]);
+        if (ops->decode(f->opaque, p, i, hdr, f->buf + pos, len, errp)) {
+            return -1;
+        }
+        pos += len;
+    }
+
+    if (pos != in_size) {
+        error_setg(errp, "multifd %u: packet size received %u size used %u",
+                   p->id, in_size, pos);
+        return -1;
+    }
+    return 0;
+
+truncated:
+    error_setg(errp, "multifd %u: truncated %s packet", p->id, ops->name);
+    return -1;
+}
@@ -0,0 +1,147 @@
+/*
+ * Multifd LZ4 compression implementation
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include <lz4.h>
+#include "qemu/rcu.h"
+#include "exec/ramblock.h"
+#include "exec/target_page.h"
+#include "qapi/error.h"
+#include "migration.h"
+#include "options.h"
+#include "multifd.h"
+
+/*
+ * Each normal page of a packet is framed with a header holding either
+ * LZ4_PAGE_RAW, followed by the whole page, or the length of the LZ4
+ * block that follows.  Pages are compressed independently, so the
+ * destination needs no state across packets.
+ */
+#define LZ4_PAGE_RAW  0x80000000u
+
+/*
+ * Compressing a page that ends up sent raw is pure CPU overhead, and memory
+ * that does not compress tends to come in large runs.  Try the first few
+ * pages of each packet; if none of them saves at least 1/8th of its size,
+ * send the rest of the packet raw.
+ */
+#define LZ4_SAMPLE_PAGES  8
+
+struct lz4_data {
+    /* whether to try compressing the next page of the packet */
+    bool try;
+    /* whether a page of the packet was compressed so far */
+    bool saved;
+};
+
+/* Multifd LZ4 compression */
+
+static uint32_t multifd_lz4_encode_page(void *opaque, MultiFDSendParams *p,
+                                        uint32_t index, const uint8_t *page,
+                                        uint8_t *out, uint32_t *len)
+{
+    struct lz4_data *z = opaque;
+    uint32_t page_size = multifd_ram_page_size();
+    int ret = 0;
+
+    if (index == 0) {
+        z->try = true;
+        z->saved = false;
+    }
+
+    if (z->try) {
+        ret = LZ4_compress_default((const char *)page, (char *)out,
+                                   page_size, page_size - page_size / 8);
+    }
+
+    z->saved |= ret > 0;
+    if (index + 1 == LZ4_SAMPLE_PAGES) {
+        z->try = z->saved;
+    }
+
+    if (ret <= 0) {
+        memcpy(out, page, page_size);
+        *len = page_size;
+        return LZ4_PAGE_RAW;
+    }
+    *len = ret;
+    return ret;
+}
+
+static uint32_t multifd_lz4_payload_len(uint32_t hdr)
+{
+    return hdr == LZ4_PAGE_RAW ? multifd_ram_page_size() : hdr;
+}
+
+static int multifd_lz4_decode_page(void *opaque, MultiFDRecvParams *p,
+                                   uint32_t index, uint32_t hdr,
+                                   const uint8_t *in, uint32_t len,
+                                   Error **errp)
+{
+    uint32_t page_size = multifd_ram_page_size();
+    uint8_t *page = p->host + p->normal[index];
+
+    if (hdr == LZ4_PAGE_RAW) {
+        memcpy(page, in, page_size);
+    } else if (LZ4_decompress_safe((const char *)in, (char *)page,
+                                   len, page_size) != page_size) {
+        error_setg(errp, "multifd %u: failed to decompress page at 0x%"
+                   PRIx64, p->id, p->normal[index]);
+        return -1;
+    }
+    return 0;
+}
+
+static const MultiFDFramedOps multifd_lz4_framed_ops = {
+    .flag = MULTIFD_FLAG_LZ4,
+    .name = "lz4",
+    .encode = multifd_lz4_encode_page,
+    .payload_len = multifd_lz4_payload_len,
+    .decode = multifd_lz4_decode_page,
+};
+
+static int multifd_lz4_send_setup(MultiFDSendParams *p, Error **errp)
+{
+    struct lz4_data *z = g_new0(struct lz4_data, 1);
+
+    if (multifd_framed_send_setup(p, &multifd_lz4_framed_ops, z, errp)) {
+        g_free(z);
+        return -1;
+    }
+    return 0;
+}
+
+static void multifd_lz4_send_cleanup(MultiFDSendParams *p, Error **errp)
+{
+    g_free(multifd_framed_send_cleanup(p));
+}
+
+static int multifd_lz4_recv_setup(MultiFDRecvParams *p, Error **errp)
+{
+    return multifd_framed_recv_setup(p, &multifd_lz4_framed_ops, NULL, errp);
+}
+
+static void multifd_lz4_recv_cleanup(MultiFDRecvParams *p)
+{
+    multifd_framed_recv_cleanup(p);
+}
+
+static const MultiFDMethods multifd_lz4_ops = {
+    .send_setup = multifd_lz4_send_setup,
+    .send_cleanup = multifd_lz4_send_cleanup,
+    .send_prepare = multifd_framed_send_prepare,
+    .recv_setup = multifd_lz4_recv_setup,
+    .recv_cleanup = multifd_lz4_recv_cleanup,
+    .recv = multifd_framed_recv
+};
+
+static void multifd_lz4_register(void)
+{
+    multifd_register_ops(MULTIFD_COMPRESSION_LZ4, &multifd_lz4_ops);
+}
+
+migration_init(multifd_lz4_register);
@@ -0,0 +1,228 @@
+/*
+ * Multifd XBZRLE delta encoding implementation
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/rcu.h"
+#include "exec/ramblock.h"
+#include "exec/target_page.h"
+#include "qapi/error.h"
+#include "migration.h"
+#include "migration-stats.h"
+#include "options.h"
+#include "page_cache.h"
+#include "ram.h"
+#include "xbzrle.h"
+#include "multifd.h"
+
+/*
+ * Each normal page of a packet is framed with a header holding either
+ * XBZRLE_PAGE_RAW, followed by the whole page, or the length of the
+ * XBZRLE delta that follows, against the previous version of the page.
+ * The destination applies deltas directly on guest memory, which holds
+ * that previous version: a page is sent at most once per dirty bitmap
+ * round, and every round ends with a multifd sync.
+ */
+#define XBZRLE_PAGE_RAW  0x80000000u
+
+/*
+ * Pages of one RAMBlock are spread over all the channels, and a page may go
+ * through a different channel in each round, so all channels share one
+ * cache of the last version sent.  The cache is direct mapped, with a
+ * power of 2 number of slots indexed by the low bits of the page number,
+ * so stripe the locks on the low bits of the slot number.
+ */
+#define XBZRLE_CACHE_LOCKS  64
+
+static struct {
+    PageCache *cache;
+    QemuMutex lock[XBZRLE_CACHE_LOCKS];
+    /* MIN(number of slots, XBZRLE_CACHE_LOCKS) - 1 */
+    uint32_t lock_mask;
+    int users;
+} xbzrle_shared;
+
+/* Multifd XBZRLE encoding */
+
+static QemuMutex *xbzrle_cache_lock(ram_addr_t addr)
+{
+    return &xbzrle_shared.lock[(addr / multifd_ram_page_size()) &
+                               xbzrle_shared.lock_mask];
+}
+
+static bool multifd_xbzrle_cache_get(Error **errp)
+{
+    uint64_t slots = migrate_xbzrle_cache_size() / multifd_ram_page_size();
+
+    if (xbzrle_shared.users++) {
+        return true;
+    }
+
+    xbzrle_shared.cache = cache_init(migrate_xbzrle_cache_size(),
+                                     multifd_ram_page_size(), errp);
+    if (!xbzrle_shared.cache) {
+        xbzrle_shared.users = 0;
+        return false;
+    }
+    /* cache_init() made sure that slots is a power of 2 */
+    xbzrle_shared.lock_mask = MIN(slots, XBZRLE_CACHE_LOCKS) - 1;
+    for (int i = 0; i < XBZRLE_CACHE_LOCKS; i++) {
+        qemu_mutex_init(&xbzrle_shared.lock[i]);
+    }
+    return true;
+}
+
+static void multifd_xbzrle_cache_put(void)
+{
+    if (--xbzrle_shared.users) {
+        return;
+    }
+
+    cache_fini(xbzrle_shared.cache);
+    xbzrle_shared.cache = NULL;
+    for (int i = 0; i < XBZRLE_CACHE_LOCKS; i++) {
+        qemu_mutex_destroy(&xbzrle_shared.lock[i]);
+    }
+}
+
+/*
+ * Encode one page at @out, and remember what was sent.
+ */
+static uint32_t multifd_xbzrle_encode_page(void *opaque, MultiFDSendParams *p,
+                                           uint32_t index, const uint8_t *page,
+                                           uint8_t *out, uint32_t *len)
+{
+    MultiFDPages_t *pages = &p->data->u.ram;
+    ram_addr_t addr = pages->block->offset + pages->offset[index];
+    uint32_t page_size = multifd_ram_page_size();
+    uint64_t generation = stat64_get(&mig_stats.dirty_sync_count);
+    PageCache *cache = xbzrle_shared.cache;
+    int ret = -1;
+
+    QEMU_LOCK_GUARD(xbzrle_cache_lock(addr));
+
+    if (cache_is_cached(cache, addr, generation)) {
+        uint8_t *old = get_cached_data(cache, addr);
+
+        ret = xbzrle_encode_buffer(old, (uint8_t *)page, page_size,
+                                   out, page_size);
+        memcpy(old, page, page_size);
+    } else {
+        /* a failed insert just means the next round sends the page raw */
+        cache_insert(cache, addr, page, generation);
+    }
+
+    if (ret < 0) {
+        memcpy(out, page, page_size);
+        *len = page_size;
+        return XBZRLE_PAGE_RAW;
+    }
+    *len = ret;
+    return ret;
+}
+
+/*
+ * Zero pages are sent by multifd itself and zeroed on the destination;
+ * keep the cache in sync with that.
+ */
+static void multifd_xbzrle_zero_page(void *opaque, MultiFDSendParams *p,
+                                     uint32_t index)
+{
+    MultiFDPages_t *pages = &p->data->u.ram;
+    ram_addr_t addr = pages->block->offset + pages->offset[index];
+    PageCache *cache = xbzrle_shared.cache;
+    uint64_t generation = stat64_get(&mig_stats.dirty_sync_count);
+
+    QEMU_LOCK_GUARD(xbzrle_cache_lock(addr));
+
+    if (cache_is_cached(cache, addr, generation)) {
+        memset(get_cached_data(cache, addr), 0, multifd_ram_page_size());
+    }
+}
+
+static uint32_t multifd_xbzrle_payload_len(uint32_t hdr)
+{
+    return hdr == XBZRLE_PAGE_RAW ? multifd_ram_page_size() : hdr;
+}
+
+static int multifd_xbzrle_decode_page(void *opaque, MultiFDRecvParams *p,
+                                      uint32_t index, uint32_t hdr,
+                                      const uint8_t *in, uint32_t len,
+                                      Error **errp)
+{
+    uint32_t page_size = multifd_ram_page_size();
+    uint8_t *page = p->host + p->normal[index];
+
+    if (hdr == XBZRLE_PAGE_RAW) {
+        memcpy(page, in, page_size);
+    } else if (len &&
+               xbzrle_decode_buffer((uint8_t *)in, len, page, page_size) < 0) {
+        error_setg(errp, "multifd %u: failed to decode page at 0x%"
+                   PRIx64, p->id, p->normal[index]);
+        return -1;
+    }
+    return 0;
+}
+
+static const MultiFDFramedOps multifd_xbzrle_framed_ops = {
+    .flag = MULTIFD_FLAG_XBZRLE,
+    .name = "xbzrle",
+    .encode = multifd_xbzrle_encode_page,
+    .zero_page = multifd_xbzrle_zero_page,
+    .payload_len = multifd_xbzrle_payload_len,
+    .decode = multifd_xbzrle_decode_page,
+};
+
+static int multifd_xbzrle_send_setup(MultiFDSendParams *p, Error **errp)
+{
+    if (!multifd_xbzrle_cache_get(errp)) {
+        error_prepend(errp, "multifd %u: ", p->id);
+        return -1;
+    }
+
+    /* the cache is shared, so there is no per-channel state */
+    if (multifd_framed_send_setup(p, &multifd_xbzrle_framed_ops, &xbzrle_shared,
+                                  errp)) {
+        multifd_xbzrle_cache_put();
+        return -1;
+    }
+    return 0;
+}
+
+static void multifd_xbzrle_send_cleanup(MultiFDSendParams *p, Error **errp)
+{
+    /* NULL if setup failed for this channel, and has undone everything */
+    if (multifd_framed_send_cleanup(p)) {
+        multifd_xbzrle_cache_put();
+    }
+}
+
+static int multifd_xbzrle_recv_setup(MultiFDRecvParams *p, Error **errp)
+{
+    return multifd_framed_recv_setup(p, &multifd_xbzrle_framed_ops, NULL,
+                                     errp);
+}
+
+static void multifd_xbzrle_recv_cleanup(MultiFDRecvParams *p)
+{
+    multifd_framed_recv_cleanup(p);
+}
+
+static const MultiFDMethods multifd_xbzrle_ops = {
+    .send_setup = multifd_xbzrle_send_setup,
+    .send_cleanup = multifd_xbzrle_send_cleanup,
+    .send_prepare = multifd_framed_send_prepare,
+    .recv_setup = multifd_xbzrle_recv_setup,
+    .recv_cleanup = multifd_xbzrle_recv_cleanup,
+    .recv = multifd_framed_recv
+};
+
+static void multifd_xbzrle_register(void)
+{
+    multifd_register_ops(MULTIFD_COMPRESSION_XBZRLE, &multifd_xbzrle_ops);
+}
+
+migration_init(multifd_xbzrle_register);
@@ -14,11 +14,13 @@
 #include "qemu/cutils.h"
 #include "qemu/iov.h"
 #include "qemu/rcu.h"
+#include "qemu/timer.h"
 #include "exec/target_page.h"
 #include "system/system.h"
 #include "exec/ramblock.h"
 #include "qemu/error-report.h"
 #include "qapi/error.h"
+#include "qapi/util.h"
 #include "file.h"
 #include "migration/misc.h"
 #include "migration.h"
@@ -544,6 +546,30 @@ static void multifd_send_cleanup_state(void)
     multifd_send_state = NULL;
 }
 
+MultiFDChannelStatsList *multifd_send_channel_stats(void)
+{
+    MultiFDChannelStatsList *head = NULL;
+    int i;
+
+    if (!multifd_send_state || !multifd_send_state->params) {
+        return NULL;
+    }
+
+    for (i = migrate_multifd_channels() - 1; i >= 0; i--) {
+        MultiFDSendParams *p = &multifd_send_state->params[i];
+        MultiFDChannelStats *stats = g_new0(MultiFDChannelStats, 1);
+
+        stats->id = p->id;
+        stats->bytes = stat64_get(&p->raw_bytes);
+        stats->encoded_bytes = stat64_get(&p->payload_bytes);
+        stats->compression_rate = stats->encoded_bytes ?
+            (double)stats->bytes / stats->encoded_bytes : 0;
+        stats->cpu_time = stat64_get(&p->prepare_ns) / SCALE_US;
+        QAPI_LIST_PREPEND(head, stats);
+    }
+    return head;
+}
+
 void multifd_send_shutdown(void)
 {
     int i;
@@ -660,6 +686,19 @@ int multifd_send_sync_main(MultiFDSyncReq req)
     return 0;
 }
 
+/* CPU time of the calling thread, or 0 if the host can't tell */
+static int64_t multifd_thread_cpu_ns(void)
+{
+#ifdef CLOCK_THREAD_CPUTIME_ID
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0) {
+        return ts.tv_sec * NANOSECONDS_PER_SECOND + ts.tv_nsec;
+    }
+#endif
+    return 0;
+}
+
 static void *multifd_send_thread(void *opaque)
 {
     MultiFDSendParams *p = opaque;
@@ -703,10 +742,17 @@ static void *multifd_send_thread(void *opaque)
             if (is_device_state) {
                 multifd_device_state_send_prepare(p);
             } else {
+                int64_t start_ns = multifd_thread_cpu_ns();
+
                 ret = multifd_send_state->ops->send_prepare(p, &local_err);
                 if (ret != 0) {
                     break;
                 }
+                stat64_add(&p->prepare_ns,
+                           multifd_thread_cpu_ns() - start_ns);
+                stat64_add(&p->raw_bytes, (uint64_t)p->data->u.ram.normal_num *
+                                          multifd_ram_page_size());
+                stat64_add(&p->payload_bytes, p->next_packet_size);
             }
 
             /*
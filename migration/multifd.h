@@ -14,6 +14,7 @@
 #define QEMU_MIGRATION_MULTIFD_H
 
 #include "exec/target_page.h"
+#include "qemu/stats64.h"
 #include "ram.h"
 
 typedef struct MultiFDRecvData MultiFDRecvData;
@@ -38,6 +39,7 @@ typedef enum {
 bool multifd_send_setup(void);
 void multifd_send_shutdown(void);
 void multifd_send_channel_created(void);
+MultiFDChannelStatsList *multifd_send_channel_stats(void);
 int multifd_recv_setup(Error **errp);
 void multifd_recv_cleanup(void);
 void multifd_recv_shutdown(void);
@@ -61,6 +63,12 @@ MultiFDRecvData *multifd_get_recv_data(void);
 #define MULTIFD_FLAG_QPL (4 << 1)
 #define MULTIFD_FLAG_UADK (8 << 1)
 #define MULTIFD_FLAG_QATZIP (16 << 1)
+/*
+ * All five bits are taken by the methods above, but the field is always
+ * compared as a whole, so further methods use the free combinations.
+ */
+#define MULTIFD_FLAG_XBZRLE (3 << 1)
+#define MULTIFD_FLAG_LZ4 (5 << 1)
 
 /*
  * If set it means that this packet contains device state
@@ -214,6 +222,18 @@ typedef struct {
 
     MultiFDSendData *data;
 
+    /*
+     * RAM statistics, only updated by the sender thread, and read by
+     * query-migrate while it runs.
+     *
+     * @raw_bytes:     guest RAM sent, not counting zero pages
+     * @payload_bytes: what @raw_bytes took once encoded by the method
+     * @prepare_ns:    thread CPU time spent in the method's send_prepare()
+     */
+    Stat64 raw_bytes;
+    Stat64 payload_bytes;
+    Stat64 prepare_ns;
+
     /* thread local variables. No locking required */
 
     /* pointers to the possible packet types */
@@ -377,6 +397,53 @@ bool multifd_send_prepare_common(MultiFDSendParams *p);
 void multifd_send_zero_page_detect(MultiFDSendParams *p);
 void multifd_recv_zero_page_process(MultiFDRecvParams *p);
 
+/*
+ * Framed packets, for methods that encode each normal page on its own:
+ * each one is sent as a 32-bit big endian header followed by a payload
+ * of at most one page, both defined by the method.  The methods only
+ * encode and decode pages, see multifd-framed.c.
+ */
+#define MULTIFD_FRAME_HDR_SIZE  sizeof(uint32_t)
+
+typedef struct {
+    /* MULTIFD_FLAG_* of the method, and its name for error messages */
+    uint32_t flag;
+    const char *name;
+
+    /*
+     * Encode @page, a private copy of page @index of the packet, at @out.
+     * Returns the header, and the length of the payload, at most one
+     * page, in @len.
+     */
+    uint32_t (*encode)(void *opaque, MultiFDSendParams *p, uint32_t index,
+                       const uint8_t *page, uint8_t *out, uint32_t *len);
+
+    /* Called for each zero page @index of the packet.  May be NULL. */
+    void (*zero_page)(void *opaque, MultiFDSendParams *p, uint32_t index);
+
+    /* Returns the length of the payload that follows @hdr */
+    uint32_t (*payload_len)(uint32_t hdr);
+
+    /*
+     * Decode page @index of the packet from the @len bytes at @in, which
+     * followed @hdr.  Returns 0, or -1 and sets @errp.
+     */
+    int (*decode)(void *opaque, MultiFDRecvParams *p, uint32_t index,
+                  uint32_t hdr, const uint8_t *in, uint32_t len,
+                  Error **errp);
+} MultiFDFramedOps;
+
+int multifd_framed_send_setup(MultiFDSendParams *p,
+                              const MultiFDFramedOps *ops, void *opaque,
+                              Error **errp);
+void *multifd_framed_send_cleanup(MultiFDSendParams *p);
+int multifd_framed_send_prepare(MultiFDSendParams *p, Error **errp);
+int multifd_framed_recv_setup(MultiFDRecvParams *p,
+                              const MultiFDFramedOps *ops, void *opaque,
+                              Error **errp);
+void *multifd_framed_recv_cleanup(MultiFDRecvParams *p);
+int multifd_framed_recv(MultiFDRecvParams *p, Error **errp);
+
 void multifd_channel_connect(MultiFDSendParams *p, QIOChannel *ioc);
 bool multifd_send(MultiFDSendData **send_data);
 MultiFDSendData *multifd_send_data_alloc(void);
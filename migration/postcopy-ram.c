@@ -823,22 +823,18 @@ static uint32_t get_low_time_offset(PostcopyBlocktimeContext *dc)
  * tracks down vCPU blocking time.
  *
  * @addr: faulted host virtual address
- * @ptid: faulted process thread id
+ * @cpu: index of the faulted vCPU, or -1 if unknown
  * @rb: ramblock appropriate to addr
  */
-static void mark_postcopy_blocktime_begin(uintptr_t addr, uint32_t ptid,
+static void mark_postcopy_blocktime_begin(uintptr_t addr, int cpu,
                                           RAMBlock *rb)
 {
-    int cpu, already_received;
+    int already_received;
     MigrationIncomingState *mis = migration_incoming_get_current();
     PostcopyBlocktimeContext *dc = mis->blocktime_ctx;
     uint32_t low_time_offset;
 
-    if (!dc || ptid == 0) {
-        return;
-    }
-    cpu = get_mem_fault_cpu_index(ptid);
-    if (cpu < 0) {
+    if (!dc || cpu < 0) {
         return;
     }
 
@@ -950,12 +946,122 @@ static void postcopy_pause_fault_thread(MigrationIncomingState *mis)
     trace_postcopy_pause_fault_thread_continued();
 }
 
+/*
+ * Prefetching around postcopy faults.
+ *
+ * Each vCPU has a stream that remembers the distance between its last two
+ * faults; faults that can't be tied to a vCPU share one more stream.  When
+ * two consecutive faults are the same distance apart, the next pages along
+ * that stride are requested right after the faulting one.  Every time the
+ * vCPU then faults just past the requested window, the window doubles, up
+ * to the postcopy-prefetch-pages parameter.
+ */
+#define POSTCOPY_PREFETCH_MAX_STRIDE   16   /* host pages */
+#define POSTCOPY_PREFETCH_START_PAGES  4
+
+typedef struct PostcopyPrefetchStream {
+    RAMBlock *rb;
+    /* offset of the last fault in @rb */
+    ram_addr_t last;
+    /* distance from the fault before, in bytes */
+    int64_t stride;
+    /* pages requested ahead of @last, 0 if the stream is not detected */
+    uint32_t depth;
+} PostcopyPrefetchStream;
+
+/* Request @count pages of @rb every @stride bytes after @start */
+static void postcopy_prefetch_request(MigrationIncomingState *mis,
+                                      RAMBlock *rb, ram_addr_t start,
+                                      int64_t stride, uint32_t count)
+{
+    size_t pagesize = qemu_ram_pagesize(rb);
+    /* the length of a request is 32 bits on the wire */
+    size_t max_run_len = ROUND_DOWN(UINT32_MAX, pagesize);
+    ram_addr_t run = 0;
+    size_t run_len = 0;
+    uint32_t i;
+
+    for (i = 1; i <= count; i++) {
+        int64_t offset = (int64_t)start + stride * i;
+
+        if (offset < 0 || offset >= rb->used_length) {
+            break;
+        }
+        if (ramblock_recv_bitmap_test_byte_offset(rb, offset) ||
+            ramblock_page_is_discarded(rb, offset)) {
+            continue;
+        }
+        if (run_len && offset == run + run_len &&
+            run_len + pagesize <= max_run_len) {
+            run_len += pagesize;
+            continue;
+        }
+        if (run_len) {
+            trace_postcopy_prefetch_request(qemu_ram_get_idstr(rb), run,
+                                            run_len);
+            migrate_send_rp_message_req_range(mis, rb, run, run_len);
+        }
+        run = offset;
+        run_len = pagesize;
+    }
+
+    if (run_len) {
+        trace_postcopy_prefetch_request(qemu_ram_get_idstr(rb), run, run_len);
+        migrate_send_rp_message_req_range(mis, rb, run, run_len);
+    }
+}
+
+/*
+ * Called after requesting the page at @offset in @rb, which faulted in
+ * the vCPU of @s.  Errors are not reported: the source has to answer the
+ * fault first anyway, and the next fault will notice a broken channel.
+ */
+static void postcopy_prefetch(MigrationIncomingState *mis,
+                              PostcopyPrefetchStream *s, RAMBlock *rb,
+                              ram_addr_t offset)
+{
+    uint32_t max = migrate_postcopy_prefetch_pages();
+    int64_t max_stride = POSTCOPY_PREFETCH_MAX_STRIDE * qemu_ram_pagesize(rb);
+    int64_t delta = (int64_t)(offset - s->last);
+    int64_t stride = delta;
+    uint32_t depth;
+
+    if (rb != s->rb) {
+        s->rb = rb;
+        stride = 0;
+        depth = 0;
+    } else if (s->depth && delta == s->stride * (s->depth + 1)) {
+        /* just past the window: keep going, further */
+        stride = s->stride;
+        depth = MIN(s->depth * 2, max);
+    } else if (s->depth && !(delta % s->stride) &&
+               delta / s->stride >= 1 && delta / s->stride <= s->depth) {
+        /* a prefetched page that has not arrived yet */
+        return;
+    } else if (delta && delta == s->stride && llabs(delta) <= max_stride) {
+        depth = MIN(POSTCOPY_PREFETCH_START_PAGES, max);
+    } else {
+        depth = 0;
+    }
+
+    s->last = offset;
+    s->stride = stride;
+    s->depth = depth;
+    if (depth) {
+        postcopy_prefetch_request(mis, rb, offset, stride, depth);
+    }
+}
+
 /*
  * Handle faults detected by the USERFAULT markings
  */
 static void *postcopy_ram_fault_thread(void *opaque)
 {
     MigrationIncomingState *mis = opaque;
+    MachineState *ms = MACHINE(qdev_get_machine());
+    /* one prefetch stream per vCPU, and a last one for unknown threads */
+    unsigned int nr_streams = ms->smp.cpus + 1;
+    PostcopyPrefetchStream *streams;
     struct uffd_msg msg;
     int ret;
     size_t index;
@@ -970,6 +1076,7 @@ static void *postcopy_ram_fault_thread(void *opaque)
     size_t pfd_len = 2 + mis->postcopy_remote_fds->len;
 
     pfd = g_new0(struct pollfd, pfd_len);
+    streams = g_new0(PostcopyPrefetchStream, nr_streams);
 
     pfd[0].fd = mis->userfault_fd;
     pfd[0].events = POLLIN;
@@ -988,6 +1095,7 @@ static void *postcopy_ram_fault_thread(void *opaque)
     while (true) {
         ram_addr_t rb_offset;
         int poll_result;
+        int cpu;
 
         /*
          * We're mainly waiting for the kernel to give us a faulting HVA,
@@ -1068,9 +1176,13 @@ static void *postcopy_ram_fault_thread(void *opaque)
                                                 qemu_ram_get_idstr(rb),
                                                 rb_offset,
                                                 msg.arg.pagefault.feat.ptid);
+            cpu = -1;
+            if (msg.arg.pagefault.feat.ptid &&
+                (mis->blocktime_ctx || migrate_postcopy_prefetch_pages())) {
+                cpu = get_mem_fault_cpu_index(msg.arg.pagefault.feat.ptid);
+            }
             mark_postcopy_blocktime_begin(
-                    (uintptr_t)(msg.arg.pagefault.address),
-                                msg.arg.pagefault.feat.ptid, rb);
+                    (uintptr_t)(msg.arg.pagefault.address), cpu, rb);
 
 retry:
             /*
@@ -1084,6 +1196,13 @@ retry:
                 postcopy_pause_fault_thread(mis);
                 goto retry;
             }
+
+            if (migrate_postcopy_prefetch_pages()) {
+                if (cpu < 0 || cpu >= nr_streams - 1) {
+                    cpu = nr_streams - 1;
+                }
+                postcopy_prefetch(mis, &streams[cpu], rb, rb_offset);
+            }
         }
 
         /* Now handle any requests from external processes on shared memory */
@@ -1144,6 +1263,7 @@ retry:
     }
     rcu_unregister_thread();
     trace_postcopy_ram_fault_thread_exit();
+    g_free(streams);
     g_free(pfd);
     return NULL;
 }
@@ -32,6 +32,7 @@
 #include "qemu/bitmap.h"
 #include "qemu/madvise.h"
 #include "qemu/main-loop.h"
+#include "block/thread-pool.h"
 #include "xbzrle.h"
 #include "ram.h"
 #include "migration.h"
@@ -382,6 +383,8 @@ struct RAMState {
      * - pss structures
      */
     QemuMutex bitmap_mutex;
+    /* Threads that sync the dirty bitmap of large RAMBlocks in chunks */
+    ThreadPool *sync_pool;
     /* The RAMBlock used in the last src_page_requests */
     RAMBlock *last_req_rb;
     /* Queue of outstanding page requests from the destination */
@@ -896,6 +899,94 @@ static void ramblock_sync_dirty_bitmap(RAMState *rs, RAMBlock *rb)
     rs->num_dirty_pages_period += new_dirty_pages;
 }
 
+/*
+ * With multifd, the dirty bitmap of every RAMBlock is synced in chunks of
+ * this size by a pool of threads, one per channel.  A chunk covers whole
+ * words of the migration and clear bitmaps, so chunks never share a word
+ * that is updated non-atomically.
+ */
+#define RAM_SYNC_CHUNK_SIZE  (1ULL << 30)
+
+typedef struct {
+    RAMBlock *rb;
+    ram_addr_t start;
+    ram_addr_t length;
+    uint64_t new_dirty_pages;
+} RAMSyncChunk;
+
+static int ram_sync_chunk(void *opaque)
+{
+    RAMSyncChunk *chunk = opaque;
+
+    /*
+     * The pool threads are not RCU readers, but the migration thread holds
+     * the RCU read lock until all of them are done.
+     */
+    chunk->new_dirty_pages =
+        cpu_physical_memory_sync_dirty_bitmap(chunk->rb, chunk->start,
+                                              chunk->length);
+    return 0;
+}
+
+/*
+ * Splitting the sync only pays off once some RAMBlock spans several
+ * chunks; smaller guests keep syncing on the migration thread.
+ */
+static bool ram_sync_wants_chunks(void)
+{
+    RAMBlock *block;
+
+    RCU_READ_LOCK_GUARD();
+    RAMBLOCK_FOREACH_NOT_IGNORED(block) {
+        if (block->used_length > RAM_SYNC_CHUNK_SIZE) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Called with RCU critical section and bitmap_mutex held */
+static void ram_sync_dirty_bitmaps(RAMState *rs)
+{
+    g_autofree RAMSyncChunk *chunks = NULL;
+    uint64_t new_dirty_pages = 0;
+    size_t n = 0, i = 0;
+    RAMBlock *block;
+
+    if (!rs->sync_pool) {
+        RAMBLOCK_FOREACH_NOT_IGNORED(block) {
+            ramblock_sync_dirty_bitmap(rs, block);
+        }
+        return;
+    }
+
+    RAMBLOCK_FOREACH_NOT_IGNORED(block) {
+        n += DIV_ROUND_UP(block->used_length, RAM_SYNC_CHUNK_SIZE);
+    }
+    chunks = g_new(RAMSyncChunk, n);
+
+    RAMBLOCK_FOREACH_NOT_IGNORED(block) {
+        for (ram_addr_t start = 0; start < block->used_length;
+             start += RAM_SYNC_CHUNK_SIZE, i++) {
+            chunks[i] = (RAMSyncChunk) {
+                .rb = block,
+                .start = start,
+                .length = MIN(RAM_SYNC_CHUNK_SIZE,
+                              block->used_length - start),
+            };
+            thread_pool_submit(rs->sync_pool, ram_sync_chunk, &chunks[i],
+                               NULL);
+        }
+    }
+    thread_pool_wait(rs->sync_pool);
+
+    for (i = 0; i < n; i++) {
+        new_dirty_pages += chunks[i].new_dirty_pages;
+    }
+    rs->migration_dirty_pages += new_dirty_pages;
+    rs->num_dirty_pages_period += new_dirty_pages;
+}
+
 /**
  * ram_pagesize_summary: calculate all the pagesizes of a VM
  *
@@ -1017,7 +1108,7 @@ static void migration_trigger_throttle(RAMState *rs)
 
 static void migration_bitmap_sync(RAMState *rs, bool last_stage)
 {
-    RAMBlock *block;
+    int64_t start_us, log_us;
     int64_t end_time;
 
     stat64_add(&mig_stats.dirty_sync_count, 1);
@@ -1026,17 +1117,27 @@ static void migration_bitmap_sync(RAMState *rs, bool last_stage)
         rs->time_last_bitmap_sync = qemu_clock_get_ms(QEMU_CLOCK_REALTIME);
     }
 
+    if (!rs->sync_pool && migrate_multifd() &&
+        migrate_multifd_channels() > 1 && ram_sync_wants_chunks()) {
+        rs->sync_pool = thread_pool_new();
+        thread_pool_set_max_threads(rs->sync_pool,
+                                    migrate_multifd_channels());
+    }
+
     trace_migration_bitmap_sync_start();
+    start_us = qemu_clock_get_us(QEMU_CLOCK_REALTIME);
     memory_global_dirty_log_sync(last_stage);
+    log_us = qemu_clock_get_us(QEMU_CLOCK_REALTIME);
+    stat64_set(&mig_stats.dirty_sync_log_time, log_us - start_us);
 
     WITH_QEMU_LOCK_GUARD(&rs->bitmap_mutex) {
         WITH_RCU_READ_LOCK_GUARD() {
-            RAMBLOCK_FOREACH_NOT_IGNORED(block) {
-                ramblock_sync_dirty_bitmap(rs, block);
-            }
+            ram_sync_dirty_bitmaps(rs);
             stat64_set(&mig_stats.dirty_bytes_last_sync, ram_bytes_remaining());
         }
     }
+    stat64_set(&mig_stats.dirty_sync_bitmap_time,
+               qemu_clock_get_us(QEMU_CLOCK_REALTIME) - log_us);
 
     memory_global_after_dirty_log_sync();
     trace_migration_bitmap_sync_end(rs->num_dirty_pages_period);
@@ -2275,6 +2376,9 @@ static void xbzrle_load_cleanup(void)
 static void ram_state_cleanup(RAMState **rsp)
 {
     if (*rsp) {
+        if ((*rsp)->sync_pool) {
+            thread_pool_free((*rsp)->sync_pool);
+        }
         migration_page_queue_free(*rsp);
         qemu_mutex_destroy(&(*rsp)->bitmap_mutex);
         qemu_mutex_destroy(&(*rsp)->src_page_req_mutex);
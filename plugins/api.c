@@ -123,6 +123,20 @@ void qemu_plugin_register_vcpu_tb_exec_inline_per_vcpu(
     }
 }
 
+void qemu_plugin_register_vcpu_tb_exit_inline_per_vcpu(
+    struct qemu_plugin_tb *tb,
+    enum qemu_plugin_tb_exit exit,
+    enum qemu_plugin_op op,
+    qemu_plugin_u64 entry,
+    uint64_t imm)
+{
+    g_assert((unsigned)exit < ARRAY_SIZE(tb->exit_cbs));
+    if (!tb_is_mem_only() && qemu_plugin_tb_has_exit(tb, exit)) {
+        plugin_register_inline_op_on_entry(&tb->exit_cbs[exit], 0, op,
+                                           entry, imm);
+    }
+}
+
 void qemu_plugin_register_vcpu_insn_exec_cb(struct qemu_plugin_insn *insn,
                                             qemu_plugin_vcpu_udata_cb_t cb,
                                             enum qemu_plugin_cb_flags flags,
@@ -188,6 +202,13 @@ void qemu_plugin_register_vcpu_mem_inline_per_vcpu(
     plugin_register_inline_op_on_entry(&insn->mem_cbs, rw, op, entry, imm);
 }
 
+void qemu_plugin_register_vcpu_mem_buffer(struct qemu_plugin_insn *insn,
+                                          enum qemu_plugin_mem_rw rw,
+                                          struct qemu_plugin_mem_buffer *buf)
+{
+    plugin_register_vcpu_mem_buffer(&insn->mem_cbs, rw, buf, insn->vaddr);
+}
+
 void qemu_plugin_register_vcpu_tb_trans_cb(qemu_plugin_id_t id,
                                            qemu_plugin_vcpu_tb_trans_cb_t cb)
 {
@@ -228,6 +249,12 @@ size_t qemu_plugin_tb_n_insns(const struct qemu_plugin_tb *tb)
     return tb->n;
 }
 
+bool qemu_plugin_tb_has_exit(const struct qemu_plugin_tb *tb,
+                             enum qemu_plugin_tb_exit exit)
+{
+    return tb->exits & (1u << exit);
+}
+
 uint64_t qemu_plugin_tb_vaddr(const struct qemu_plugin_tb *tb)
 {
     const DisasContextBase *db = tcg_ctx->plugin_db;
@@ -472,13 +499,48 @@ void qemu_plugin_scoreboard_free(struct qemu_plugin_scoreboard *score)
     plugin_scoreboard_free(score);
 }
 
+struct qemu_plugin_mem_buffer *
+qemu_plugin_mem_buffer_new(size_t n_records,
+                           qemu_plugin_vcpu_mem_buf_cb_t cb,
+                           void *userdata)
+{
+    struct qemu_plugin_mem_buffer *buf;
+
+    QEMU_BUILD_BUG_ON(sizeof(qemu_plugin_mem_record) != 24);
+    g_assert(cb);
+    /*
+     * Room for every access of one instruction is reserved up front,
+     * so keep the buffer large enough for the widest vector load/store.
+     */
+    n_records = MAX(n_records, PLUGIN_MEM_BUFFER_MIN);
+    buf = g_new0(struct qemu_plugin_mem_buffer, 1);
+    buf->score = plugin_scoreboard_new(PLUGIN_MEM_BUFFER_HDR +
+                                       n_records *
+                                       sizeof(qemu_plugin_mem_record));
+    buf->n_records = n_records;
+    buf->cb = cb;
+    buf->userdata = userdata;
+    return buf;
+}
+
+void qemu_plugin_mem_buffer_free(struct qemu_plugin_mem_buffer *buf)
+{
+    plugin_scoreboard_free(buf->score);
+    g_free(buf);
+}
+
+void qemu_plugin_mem_buffer_flush(struct qemu_plugin_mem_buffer *buf,
+                                  unsigned int vcpu_index)
+{
+    g_assert(vcpu_index < qemu_plugin_num_vcpus());
+    plugin_mem_buffer_drain(vcpu_index, buf);
+}
+
 void *qemu_plugin_scoreboard_find(struct qemu_plugin_scoreboard *score,
                                   unsigned int vcpu_index)
 {
     g_assert(vcpu_index < qemu_plugin_num_vcpus());
-    /* we can't use g_array_index since entry size is not statically known */
-    char *base_ptr = score->data->data;
-    return base_ptr + vcpu_index * g_array_get_element_size(score->data);
+    return qatomic_rcu_read(&score->data) + vcpu_index * score->element_size;
 }
 
 static uint64_t *plugin_u64_address(qemu_plugin_u64 entry,
@@ -508,9 +570,14 @@ void qemu_plugin_u64_set(qemu_plugin_u64 entry, unsigned int vcpu_index,
 
 uint64_t qemu_plugin_u64_sum(qemu_plugin_u64 entry)
 {
+    /* the vCPU count must be read before the data, see plugin_num_vcpus */
+    int n = qemu_plugin_num_vcpus();
+    const char *ptr = qatomic_rcu_read(&entry.score->data) + entry.offset;
+    size_t stride = entry.score->element_size;
     uint64_t total = 0;
-    for (int i = 0, n = qemu_plugin_num_vcpus(); i < n; ++i) {
-        total += qemu_plugin_u64_get(entry, i);
+
+    for (int i = 0; i < n; ++i, ptr += stride) {
+        total += *(const uint64_t *)ptr;
     }
     return total;
 }
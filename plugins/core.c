@@ -12,7 +12,9 @@
  * SPDX-License-Identifier: GPL-2.0-or-later
  */
 #include "qemu/osdep.h"
+#include "qemu/cacheinfo.h"
 #include "qemu/lockable.h"
+#include "qemu/memalign.h"
 #include "qemu/option.h"
 #include "qemu/plugin.h"
 #include "qemu/queue.h"
@@ -204,6 +206,14 @@ CPUPluginState *qemu_plugin_create_vcpu_state(void)
     return g_new0(CPUPluginState, 1);
 }
 
+static char *plugin_scoreboard_alloc(size_t element_size, size_t n)
+{
+    char *data = qemu_memalign(qemu_dcache_linesize, element_size * n);
+
+    memset(data, 0, element_size * n);
+    return data;
+}
+
 static void plugin_grow_scoreboards__locked(CPUState *cpu)
 {
     size_t scoreboard_size = plugin.scoreboard_alloc_size;
@@ -243,7 +253,19 @@ static void plugin_grow_scoreboards__locked(CPUState *cpu)
     if (scoreboard_size > plugin.scoreboard_alloc_size) {
         struct qemu_plugin_scoreboard *score;
         QLIST_FOREACH(score, &plugin.scoreboards, entry) {
-            g_array_set_size(score->data, scoreboard_size);
+            char *old = score->data;
+            char *new = plugin_scoreboard_alloc(score->element_size,
+                                                scoreboard_size);
+
+            memcpy(new, old, score->element_size *
+                   plugin.scoreboard_alloc_size);
+            qatomic_rcu_set(&score->data, new);
+            /*
+             * Plugin-owned threads are not RCU readers, so we cannot tell
+             * when they are done with the old array.  Sizes double, so
+             * keeping the old arrays at most doubles the footprint.
+             */
+            score->retired = g_slist_prepend(score->retired, old);
         }
         plugin.scoreboard_alloc_size = scoreboard_size;
         /* force all tb to be flushed, as scoreboard pointers were changed. */
@@ -258,12 +280,18 @@ static void qemu_plugin_vcpu_init__async(CPUState *cpu, run_on_cpu_data unused)
 
     assert(cpu->cpu_index != UNASSIGNED_CPU_INDEX);
     qemu_rec_mutex_lock(&plugin.lock);
-    plugin.num_vcpus = MAX(plugin.num_vcpus, cpu->cpu_index + 1);
     plugin_cpu_update__locked(&cpu->cpu_index, NULL, NULL);
     success = g_hash_table_insert(plugin.cpu_ht, &cpu->cpu_index,
                                   &cpu->cpu_index);
     g_assert(success);
     plugin_grow_scoreboards__locked(cpu);
+    /*
+     * Publish the new vCPU count only once the scoreboards can hold it:
+     * plugin-owned threads read the count and then the scoreboard data
+     * without taking the lock.
+     */
+    qatomic_store_release(&plugin.num_vcpus,
+                          MAX(plugin.num_vcpus, cpu->cpu_index + 1));
     qemu_rec_mutex_unlock(&plugin.lock);
 
     plugin_vcpu_cb__simple(cpu, QEMU_PLUGIN_EV_VCPU_INIT);
@@ -457,6 +485,102 @@ void plugin_register_vcpu_mem_cb(GArray **arr,
     dyn_cb->regular = regular_cb;
 }
 
+void plugin_register_vcpu_mem_buffer(GArray **arr,
+                                     enum qemu_plugin_mem_rw rw,
+                                     struct qemu_plugin_mem_buffer *buf,
+                                     uint64_t insn_vaddr)
+{
+    /*
+     * The drain helper is only called once the buffer is full, and
+     * neither reads nor writes guest registers.
+     */
+    static TCGHelperInfo info = {
+        .flags = TCG_CALL_NO_RWG,
+        /* Match qemu_plugin_vcpu_udata_cb_t, as plugin_mem_buffer_drain */
+        .typemask = (dh_typemask(void, 0) |
+                     dh_typemask(i32, 1) |
+                     dh_typemask(ptr, 2))
+    };
+    /* Likewise, but called on every access of oversized instructions. */
+    static TCGHelperInfo append_info = {
+        .flags = TCG_CALL_NO_RWG,
+        /* Match plugin_mem_buffer_append */
+        .typemask = (dh_typemask(void, 0) |
+                     dh_typemask(i32, 1) |
+                     dh_typemask(i32, 2) |
+                     dh_typemask(i64, 3) |
+                     dh_typemask(i64, 4) |
+                     dh_typemask(ptr, 5))
+    };
+
+    struct qemu_plugin_dyn_cb *dyn_cb = plugin_get_dyn_cb(arr);
+    struct qemu_plugin_buffer_cb buffer_cb = {
+        .buf = buf,
+        .drain = plugin_mem_buffer_drain,
+        .info = &info,
+        .append = plugin_mem_buffer_append,
+        .append_info = &append_info,
+        .insn_vaddr = insn_vaddr,
+        .rw = rw,
+    };
+    dyn_cb->type = PLUGIN_CB_MEM_BUFFER;
+    dyn_cb->buffer = buffer_cb;
+}
+
+static uint64_t *plugin_mem_buffer_find(struct qemu_plugin_mem_buffer *buf,
+                                        unsigned int vcpu_index)
+{
+    char *ptr = buf->score->data;
+    size_t elem_size = buf->score->element_size;
+
+    return (uint64_t *)(ptr + vcpu_index * elem_size);
+}
+
+/*
+ * Hand the records queued for @vcpu_index to the plugin.  This is called
+ * from generated code once the buffer is full, and on explicit flush.
+ */
+QEMU_DISABLE_CFI
+void plugin_mem_buffer_drain(unsigned int vcpu_index, void *opaque)
+{
+    struct qemu_plugin_mem_buffer *buf = opaque;
+    uint64_t *len = plugin_mem_buffer_find(buf, vcpu_index);
+    size_t n = *len;
+
+    if (n) {
+        buf->cb(vcpu_index, (const qemu_plugin_mem_record *)(len + 1), n,
+                buf->userdata);
+        *len = 0;
+    }
+}
+
+/*
+ * Queue one record for @vcpu_index, and hand the buffer to the plugin
+ * once it is full.  This is called from generated code for instructions
+ * that may queue more records than the buffer holds, and for accesses
+ * done by helpers.
+ */
+QEMU_DISABLE_CFI
+void plugin_mem_buffer_append(unsigned int vcpu_index,
+                              qemu_plugin_meminfo_t info, uint64_t vaddr,
+                              uint64_t insn_vaddr, void *opaque)
+{
+    struct qemu_plugin_mem_buffer *buf = opaque;
+    uint64_t *len = plugin_mem_buffer_find(buf, vcpu_index);
+    qemu_plugin_mem_record *rec;
+
+    /* A full buffer is drained before anything else can queue to it. */
+    g_assert(*len < buf->n_records);
+    rec = (qemu_plugin_mem_record *)(len + 1) + *len;
+    rec->vaddr = vaddr;
+    rec->insn_vaddr = insn_vaddr;
+    rec->info = info;
+    rec->reserved = 0;
+    if (++*len >= buf->n_records) {
+        plugin_mem_buffer_drain(vcpu_index, buf);
+    }
+}
+
 /*
  * Disable CFI checks.
  * The callback function has been loaded from an external library so we do not
@@ -575,9 +699,8 @@ void exec_inline_op(enum plugin_dyn_cb_type type,
                     struct qemu_plugin_inline_cb *cb,
                     int cpu_index)
 {
-    char *ptr = cb->entry.score->data->data;
-    size_t elem_size = g_array_get_element_size(
-        cb->entry.score->data);
+    char *ptr = cb->entry.score->data;
+    size_t elem_size = cb->entry.score->element_size;
     size_t offset = cb->entry.offset;
     uint64_t *val = (uint64_t *)(ptr + offset + cpu_index * elem_size);
 
@@ -626,6 +749,14 @@ void qemu_plugin_vcpu_mem_cb(CPUState *cpu, uint64_t vaddr,
                 exec_inline_op(cb->type, &cb->inline_insn, cpu->cpu_index);
             }
             break;
+        case PLUGIN_CB_MEM_BUFFER:
+            if (rw & cb->buffer.rw) {
+                plugin_mem_buffer_append(cpu->cpu_index,
+                                         make_plugin_meminfo(oi, rw), vaddr,
+                                         cb->buffer.insn_vaddr,
+                                         cb->buffer.buf);
+            }
+            break;
         default:
             g_assert_not_reached();
         }
@@ -734,17 +865,18 @@ static void __attribute__((__constructor__)) plugin_init(void)
 
 int plugin_num_vcpus(void)
 {
-    return plugin.num_vcpus;
+    return qatomic_load_acquire(&plugin.num_vcpus);
 }
 
 struct qemu_plugin_scoreboard *plugin_scoreboard_new(size_t element_size)
 {
     struct qemu_plugin_scoreboard *score =
         g_malloc0(sizeof(struct qemu_plugin_scoreboard));
-    score->data = g_array_new(FALSE, TRUE, element_size);
-    g_array_set_size(score->data, plugin.scoreboard_alloc_size);
+    score->element_size = QEMU_ALIGN_UP(element_size, qemu_dcache_linesize);
 
     qemu_rec_mutex_lock(&plugin.lock);
+    score->data = plugin_scoreboard_alloc(score->element_size,
+                                          plugin.scoreboard_alloc_size);
     QLIST_INSERT_HEAD(&plugin.scoreboards, score, entry);
     qemu_rec_mutex_unlock(&plugin.lock);
 
@@ -757,6 +889,7 @@ void plugin_scoreboard_free(struct qemu_plugin_scoreboard *score)
     QLIST_REMOVE(score, entry);
     qemu_rec_mutex_unlock(&plugin.lock);
 
-    g_array_free(score->data, TRUE);
+    g_slist_free_full(score->retired, qemu_vfree);
+    qemu_vfree(score->data);
     g_free(score);
 }
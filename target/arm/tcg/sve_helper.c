@@ -6740,6 +6740,31 @@ static target_ulong off_zd_d(void *reg, intptr_t reg_ofs)
     return *(uint64_t *)(reg + reg_ofs);
 }
 
+/*
+ * Gather elements frequently share a page with the previous active
+ * element.  For loads, a successful probe of RAM yields flags, attrs
+ * and tagging that hold for the whole page, so reuse it rather than
+ * going back through the TLB for each element.  *prev records the
+ * address of the last cached probe and is -1 when there is none.
+ * Stores are not handled: probing for write also performs the
+ * notdirty processing for exactly the bytes being probed.
+ */
+static inline QEMU_ALWAYS_INLINE
+void sve_probe_page_gather(SVEHostPage *info, target_ulong *prev,
+                           CPUARMState *env, target_ulong addr,
+                           int mmu_idx, uintptr_t retaddr)
+{
+    if (*prev != -1 && !((addr ^ *prev) & TARGET_PAGE_MASK)) {
+        info->host += (intptr_t)(addr - *prev);
+        *prev = addr;
+        return;
+    }
+
+    sve_probe_page(info, false, env, addr, 0, MMU_DATA_LOAD,
+                   mmu_idx, retaddr);
+    *prev = info->flags & TLB_MMIO ? -1 : addr;
+}
+
 static inline QEMU_ALWAYS_INLINE
 void sve_ld1_z(CPUARMState *env, void *vd, uint64_t *vg, void *vm,
                target_ulong base, uint32_t desc, uintptr_t retaddr,
@@ -6754,6 +6779,7 @@ void sve_ld1_z(CPUARMState *env, void *vd, uint64_t *vg, void *vm,
     ARMVectorReg scratch;
     intptr_t reg_off;
     SVEHostPage info, info2;
+    target_ulong prev = -1;
 
     memset(&scratch, 0, reg_max);
     reg_off = 0;
@@ -6764,8 +6790,8 @@ void sve_ld1_z(CPUARMState *env, void *vd, uint64_t *vg, void *vm,
                 target_ulong addr = base + (off_fn(vm, reg_off) << scale);
                 target_ulong in_page = -(addr | TARGET_PAGE_MASK);
 
-                sve_probe_page(&info, false, env, addr, 0, MMU_DATA_LOAD,
-                               mmu_idx, retaddr);
+                sve_probe_page_gather(&info, &prev, env, addr,
+                                      mmu_idx, retaddr);
 
                 if (likely(in_page >= msize)) {
                     if (unlikely(info.flags & TLB_WATCHPOINT)) {
@@ -6795,6 +6821,7 @@ void sve_ld1_z(CPUARMState *env, void *vd, uint64_t *vg, void *vm,
                         mte_check(env, mtedesc, addr, retaddr);
                     }
                     tlb_fn(env, &scratch, reg_off, addr, retaddr);
+                    prev = -1;
                 }
             }
             reg_off += esize;
@@ -37,6 +37,8 @@ typedef struct TranslateResult {
     hwaddr paddr;
     int prot;
     int page_size;
+    /* size of the linear mapping around paddr, see lg_map_size */
+    int map_size;
 } TranslateResult;
 
 typedef enum TranslateFaultStage2 {
@@ -480,6 +482,16 @@ do_check_protect_pse36:
     out->paddr = paddr & x86_get_a20_mask(env);
     out->prot = prot;
     out->page_size = page_size;
+    /*
+     * With NPT, page_size is only good for invalidation: the stage 2
+     * page may be smaller than the stage 1 page.  With A20 masked,
+     * a large page may straddle the 1MB boundary, which is not linear.
+     */
+    if (in->ptw_idx == MMU_NESTED_IDX || x86_get_a20_mask(env) != -1) {
+        out->map_size = TARGET_PAGE_SIZE;
+    } else {
+        out->map_size = page_size;
+    }
     return true;
 
  do_fault_rsvd:
@@ -603,6 +615,7 @@ static bool get_physical_address(CPUX86State *env, vaddr addr,
     out->paddr = addr & x86_get_a20_mask(env);
     out->prot = PAGE_READ | PAGE_WRITE | PAGE_EXEC;
     out->page_size = TARGET_PAGE_SIZE;
+    out->map_size = TARGET_PAGE_SIZE;
     return true;
 }
 
@@ -618,13 +631,19 @@ bool x86_cpu_tlb_fill(CPUState *cs, vaddr addr, int size,
                              retaddr)) {
         /*
          * Even if 4MB pages, we map only one 4KB page in the cache to
-         * avoid filling it too fast.
+         * avoid filling it too fast.  The other 4KB pages are filled
+         * by the core tlb from map_size, without another page walk.
          */
+        CPUTLBEntryFull full = {
+            .phys_addr = out.paddr & TARGET_PAGE_MASK,
+            .attrs = cpu_get_mem_attrs(env),
+            .prot = out.prot,
+            .lg_page_size = ctz32(out.page_size),
+            .lg_map_size = ctz32(out.map_size),
+        };
+
         assert(out.prot & (1 << access_type));
-        tlb_set_page_with_attrs(cs, addr & TARGET_PAGE_MASK,
-                                out.paddr & TARGET_PAGE_MASK,
-                                cpu_get_mem_attrs(env),
-                                out.prot, mmu_idx, out.page_size);
+        tlb_set_page_full(cs, mmu_idx, addr & TARGET_PAGE_MASK, &full);
         return true;
     }
 
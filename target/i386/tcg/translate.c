@@ -371,6 +371,14 @@ static void assume_cc_op(DisasContext *s, CCOp op)
     set_cc_op_1(s, op, false);
 }
 
+/*
+ * Flags are evaluated lazily: at a TB boundary only cc_op and the CC_*
+ * operands it uses are spilled, and EFLAGS is computed by whoever reads
+ * it next.  Eliding even that spill based on the successor TB is not
+ * safe, because the state at every TB boundary must be architecturally
+ * complete: an interrupt, a signal frame or the gdbstub may observe
+ * EFLAGS there before the successor runs.
+ */
 static void gen_update_cc_op(DisasContext *s)
 {
     if (s->cc_op_dirty) {
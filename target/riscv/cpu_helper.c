@@ -1459,14 +1459,30 @@ static int get_physical_address(CPURISCVState *env, hwaddr *physical,
             return TRANSLATE_PMP_FAIL;
         }
 
-        if (riscv_cpu_mxl(env) == MXL_RV32) {
-            pte = address_space_ldl(cs->as, pte_addr, attrs, &res);
+        /*
+         * Valid non-leaf PTEs may be cached until the next SFENCE.VMA or
+         * HFENCE, which flush the tlb and with it the walk cache.  The
+         * cache is keyed by the physical address of the PTE, after the
+         * G-stage and PMP checks above, so a write to satp, vsatp or
+         * hgatp does not make it stale even when it does not flush the
+         * tlb: the walk simply reads from different addresses.
+         */
+        uint64_t cached_pte;
+        bool cached = !is_debug &&
+                      tlb_walk_cache_lookup(cs, pte_addr, &cached_pte);
+
+        if (cached) {
+            pte = cached_pte;
         } else {
-            pte = address_space_ldq(cs->as, pte_addr, attrs, &res);
-        }
+            if (riscv_cpu_mxl(env) == MXL_RV32) {
+                pte = address_space_ldl(cs->as, pte_addr, attrs, &res);
+            } else {
+                pte = address_space_ldq(cs->as, pte_addr, attrs, &res);
+            }
 
-        if (res != MEMTX_OK) {
-            return TRANSLATE_FAIL;
+            if (res != MEMTX_OK) {
+                return TRANSLATE_FAIL;
+            }
         }
 
         if (riscv_cpu_sxl(env) == MXL_RV32) {
@@ -1517,6 +1533,9 @@ static int get_physical_address(CPURISCVState *env, hwaddr *physical,
             return TRANSLATE_FAIL;
         }
         /* Inner PTE, continue walking */
+        if (!cached && !is_debug) {
+            tlb_walk_cache_insert(cs, pte_addr, pte);
+        }
         base = ppn << PGSHIFT;
     }
 
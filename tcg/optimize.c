@@ -2434,6 +2434,24 @@ static void fold_setcond_tst_pow2(OptContext *ctx, TCGOp *op, bool neg)
     }
 }
 
+static bool fold_set_label(OptContext *ctx, TCGOp *op)
+{
+    TCGLabel *l = arg_label(op->args[0]);
+
+    /*
+     * If every branch to the label has been folded away, the label can
+     * only be reached by falling through from the previous op, and all
+     * that we know about temps and memory still holds.  The label itself
+     * is removed by reachable_code_pass.
+     */
+    if (QSIMPLEQ_EMPTY(&l->branches)) {
+        finish_bb(ctx);
+    } else {
+        finish_ebb(ctx);
+    }
+    return true;
+}
+
 static bool fold_setcond(OptContext *ctx, TCGOp *op)
 {
     int i = do_constant_folding_cond1(ctx, op, op->args[0], &op->args[1],
@@ -3074,6 +3092,8 @@ void tcg_optimize(TCGContext *s)
             done = fold_xor(&ctx, op);
             break;
         case INDEX_op_set_label:
+            done = fold_set_label(&ctx, op);
+            break;
         case INDEX_op_br:
         case INDEX_op_exit_tb:
         case INDEX_op_goto_tb:
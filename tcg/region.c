@@ -29,6 +29,7 @@
 #include "qemu/memalign.h"
 #include "qemu/cacheinfo.h"
 #include "qemu/qtree.h"
+#include "qemu/bitmap.h"
 #include "qapi/error.h"
 #include "tcg/tcg.h"
 #include "exec/translation-block.h"
@@ -72,6 +73,8 @@ struct tcg_region_state {
     /* fields protected by the lock */
     size_t current; /* current region index */
     size_t agg_size_full; /* aggregate size of full regions */
+    size_t evict_next; /* next eviction candidate, in clock order */
+    unsigned long *evicted; /* regions emptied by eviction, to be reused */
 };
 
 static struct tcg_region_state region;
@@ -360,7 +363,14 @@ static void tcg_region_assign(TCGContext *s, size_t curr_region)
 static bool tcg_region_alloc__locked(TCGContext *s)
 {
     if (region.current == region.n) {
-        return true;
+        size_t i = find_first_bit(region.evicted, region.n);
+
+        if (i == region.n) {
+            return true;
+        }
+        clear_bit(i, region.evicted);
+        tcg_region_assign(s, i);
+        return false;
     }
     tcg_region_assign(s, region.current);
     region.current++;
@@ -412,6 +422,8 @@ void tcg_region_reset_all(void)
     qemu_mutex_lock(&region.lock);
     region.current = 0;
     region.agg_size_full = 0;
+    region.evict_next = 0;
+    bitmap_zero(region.evicted, region.n);
 
     for (i = 0; i < n_ctxs; i++) {
         TCGContext *s = qatomic_read(&tcg_ctxs[i]);
@@ -422,6 +434,74 @@ void tcg_region_reset_all(void)
     tcg_region_tree_reset_all();
 }
 
+static bool tcg_region_in_use__locked(size_t curr_region)
+{
+    unsigned int n_ctxs = qatomic_read(&tcg_cur_ctxs);
+    void *start, *end;
+    unsigned int i;
+
+    tcg_region_bounds(curr_region, &start, &end);
+    for (i = 0; i < n_ctxs; i++) {
+        const TCGContext *s = qatomic_read(&tcg_ctxs[i]);
+
+        if (s->code_gen_buffer == start) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Empty the oldest full region, so that it can be handed out again without
+ * flushing the translations held in the other regions.  Regions are picked
+ * in allocation order (a clock sweep), which approximates evicting the least
+ * recently translated code.  @func is called on each TB of the victim before
+ * it is dropped from the region tree.
+ *
+ * Returns false if there is no region to evict, in which case the caller
+ * must fall back to tcg_region_reset_all().
+ *
+ * Call from a safe-work context.
+ */
+bool tcg_region_evict(GTraverseFunc func, gpointer user_data)
+{
+    struct tcg_region_tree *rt;
+    void *start, *end;
+    size_t i, victim = region.n;
+
+    qemu_mutex_lock(&region.lock);
+    /* Only evict once every region has been handed out at least once. */
+    if (region.current == region.n) {
+        for (i = 0; i < region.n; i++) {
+            size_t r = (region.evict_next + i) % region.n;
+
+            if (!test_bit(r, region.evicted) && !tcg_region_in_use__locked(r)) {
+                victim = r;
+                break;
+            }
+        }
+    }
+    if (victim == region.n) {
+        qemu_mutex_unlock(&region.lock);
+        return false;
+    }
+    region.evict_next = (victim + 1) % region.n;
+
+    rt = region_trees + victim * tree_size;
+    qemu_mutex_lock(&rt->lock);
+    q_tree_foreach(rt->tree, func, user_data);
+    /* Increment the refcount first so that destroy acts as a reset */
+    q_tree_ref(rt->tree);
+    q_tree_destroy(rt->tree);
+    qemu_mutex_unlock(&rt->lock);
+
+    tcg_region_bounds(victim, &start, &end);
+    region.agg_size_full -= end - start - TCG_HIGHWATER;
+    set_bit(victim, region.evicted);
+    qemu_mutex_unlock(&region.lock);
+    return true;
+}
+
 static size_t tcg_n_regions(size_t tb_size, unsigned max_cpus)
 {
 #ifdef CONFIG_USER_ONLY
@@ -808,6 +888,7 @@ void tcg_region_init(size_t tb_size, int splitwx, unsigned max_cpus)
 
     /* init the region struct */
     qemu_mutex_init(&region.lock);
+    region.evicted = bitmap_new(region.n);
 
     /*
      * Set guard pages in the rw buffer, as that's the one into which
@@ -2210,6 +2210,48 @@ void tcg_gen_gvec_muli(unsigned vece, uint32_t dofs, uint32_t aofs,
     tcg_gen_gvec_muls(vece, dofs, aofs, tmp, oprsz, maxsz);
 }
 
+/*
+ * Signed saturation: overflow occurred iff the sign of the result differs
+ * from the sign of A while the signs of A and B are equal (for addition)
+ * or differ (for subtraction).  The saturated value is then INT_MAX when
+ * A is non-negative and INT_MIN otherwise.
+ */
+static void tcg_gen_ssadd_i32(TCGv_i32 d, TCGv_i32 a, TCGv_i32 b)
+{
+    TCGv_i32 r = tcg_temp_new_i32();
+    TCGv_i32 t = tcg_temp_new_i32();
+    TCGv_i32 sat = tcg_temp_new_i32();
+
+    tcg_gen_add_i32(r, a, b);
+    tcg_gen_xor_i32(t, r, a);
+    tcg_gen_xor_i32(sat, a, b);
+    tcg_gen_andc_i32(t, t, sat);
+    tcg_gen_sari_i32(sat, a, 31);
+    tcg_gen_xori_i32(sat, sat, INT32_MAX);
+    tcg_gen_movcond_i32(TCG_COND_LT, d, t, tcg_constant_i32(0), sat, r);
+    tcg_temp_free_i32(r);
+    tcg_temp_free_i32(t);
+    tcg_temp_free_i32(sat);
+}
+
+static void tcg_gen_ssadd_i64(TCGv_i64 d, TCGv_i64 a, TCGv_i64 b)
+{
+    TCGv_i64 r = tcg_temp_new_i64();
+    TCGv_i64 t = tcg_temp_new_i64();
+    TCGv_i64 sat = tcg_temp_new_i64();
+
+    tcg_gen_add_i64(r, a, b);
+    tcg_gen_xor_i64(t, r, a);
+    tcg_gen_xor_i64(sat, a, b);
+    tcg_gen_andc_i64(t, t, sat);
+    tcg_gen_sari_i64(sat, a, 63);
+    tcg_gen_xori_i64(sat, sat, INT64_MAX);
+    tcg_gen_movcond_i64(TCG_COND_LT, d, t, tcg_constant_i64(0), sat, r);
+    tcg_temp_free_i64(r);
+    tcg_temp_free_i64(t);
+    tcg_temp_free_i64(sat);
+}
+
 void tcg_gen_gvec_ssadd(unsigned vece, uint32_t dofs, uint32_t aofs,
                         uint32_t bofs, uint32_t oprsz, uint32_t maxsz)
 {
@@ -2223,11 +2265,13 @@ void tcg_gen_gvec_ssadd(unsigned vece, uint32_t dofs, uint32_t aofs,
           .fno = gen_helper_gvec_ssadd16,
           .opt_opc = vecop_list,
           .vece = MO_16 },
-        { .fniv = tcg_gen_ssadd_vec,
+        { .fni4 = tcg_gen_ssadd_i32,
+          .fniv = tcg_gen_ssadd_vec,
           .fno = gen_helper_gvec_ssadd32,
           .opt_opc = vecop_list,
           .vece = MO_32 },
-        { .fniv = tcg_gen_ssadd_vec,
+        { .fni8 = tcg_gen_ssadd_i64,
+          .fniv = tcg_gen_ssadd_vec,
           .fno = gen_helper_gvec_ssadd64,
           .opt_opc = vecop_list,
           .vece = MO_64 },
@@ -2236,6 +2280,42 @@ void tcg_gen_gvec_ssadd(unsigned vece, uint32_t dofs, uint32_t aofs,
     tcg_gen_gvec_3(dofs, aofs, bofs, oprsz, maxsz, &g[vece]);
 }
 
+static void tcg_gen_sssub_i32(TCGv_i32 d, TCGv_i32 a, TCGv_i32 b)
+{
+    TCGv_i32 r = tcg_temp_new_i32();
+    TCGv_i32 t = tcg_temp_new_i32();
+    TCGv_i32 sat = tcg_temp_new_i32();
+
+    tcg_gen_sub_i32(r, a, b);
+    tcg_gen_xor_i32(t, r, a);
+    tcg_gen_xor_i32(sat, a, b);
+    tcg_gen_and_i32(t, t, sat);
+    tcg_gen_sari_i32(sat, a, 31);
+    tcg_gen_xori_i32(sat, sat, INT32_MAX);
+    tcg_gen_movcond_i32(TCG_COND_LT, d, t, tcg_constant_i32(0), sat, r);
+    tcg_temp_free_i32(r);
+    tcg_temp_free_i32(t);
+    tcg_temp_free_i32(sat);
+}
+
+static void tcg_gen_sssub_i64(TCGv_i64 d, TCGv_i64 a, TCGv_i64 b)
+{
+    TCGv_i64 r = tcg_temp_new_i64();
+    TCGv_i64 t = tcg_temp_new_i64();
+    TCGv_i64 sat = tcg_temp_new_i64();
+
+    tcg_gen_sub_i64(r, a, b);
+    tcg_gen_xor_i64(t, r, a);
+    tcg_gen_xor_i64(sat, a, b);
+    tcg_gen_and_i64(t, t, sat);
+    tcg_gen_sari_i64(sat, a, 63);
+    tcg_gen_xori_i64(sat, sat, INT64_MAX);
+    tcg_gen_movcond_i64(TCG_COND_LT, d, t, tcg_constant_i64(0), sat, r);
+    tcg_temp_free_i64(r);
+    tcg_temp_free_i64(t);
+    tcg_temp_free_i64(sat);
+}
+
 void tcg_gen_gvec_sssub(unsigned vece, uint32_t dofs, uint32_t aofs,
                         uint32_t bofs, uint32_t oprsz, uint32_t maxsz)
 {
@@ -2249,11 +2329,13 @@ void tcg_gen_gvec_sssub(unsigned vece, uint32_t dofs, uint32_t aofs,
           .fno = gen_helper_gvec_sssub16,
           .opt_opc = vecop_list,
           .vece = MO_16 },
-        { .fniv = tcg_gen_sssub_vec,
+        { .fni4 = tcg_gen_sssub_i32,
+          .fniv = tcg_gen_sssub_vec,
           .fno = gen_helper_gvec_sssub32,
           .opt_opc = vecop_list,
           .vece = MO_32 },
-        { .fniv = tcg_gen_sssub_vec,
+        { .fni8 = tcg_gen_sssub_i64,
+          .fniv = tcg_gen_sssub_vec,
           .fno = gen_helper_gvec_sssub64,
           .opt_opc = vecop_list,
           .vece = MO_64 },
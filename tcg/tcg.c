@@ -4777,6 +4777,94 @@ static void tcg_reg_alloc_cbranch(TCGContext *s, TCGRegSet allocated_regs)
     }
 }
 
+/*
+ * If the conditional branch @op is the only use of its label, remember
+ * which globals it leaves in host registers.  They are synced to memory,
+ * so if the label cannot also be reached by falling through, the label
+ * may continue to use them.  See tcg_reg_alloc_set_label.
+ */
+static void tcg_reg_alloc_cbranch_label(TCGContext *s, const TCGOp *op)
+{
+    TCGLabel *l;
+    TCGLabelUse *use;
+
+    switch (op->opc) {
+    case INDEX_op_brcond_i32:
+    case INDEX_op_brcond_i64:
+        l = arg_label(op->args[3]);
+        break;
+    case INDEX_op_brcond2_i32:
+        l = arg_label(op->args[5]);
+        break;
+    default:
+        return;
+    }
+
+    /* Only forward branches; a backward target has already been emitted. */
+    use = QSIMPLEQ_FIRST(&l->branches);
+    if (l->has_value || use->op != op || QSIMPLEQ_NEXT(use, next)) {
+        return;
+    }
+
+    l->reg_globals = tcg_malloc(sizeof(TCGTemp *) * TCG_TARGET_NB_REGS);
+    for (int i = 0; i < TCG_TARGET_NB_REGS; i++) {
+        TCGTemp *ts = s->reg_to_temp[i];
+
+        if (ts && ts->kind == TEMP_GLOBAL && !ts->indirect_reg) {
+            tcg_debug_assert(ts->mem_coherent);
+            l->reg_globals[i] = ts;
+        } else {
+            l->reg_globals[i] = NULL;
+        }
+    }
+}
+
+/* Return true if the code before the label @op cannot fall through. */
+static bool label_no_fallthrough(const TCGOp *op)
+{
+    /* Dead insn_start are retained by reachable_code_pass. */
+    do {
+        op = QTAILQ_PREV(op, link);
+    } while (op && op->opc == INDEX_op_insn_start);
+
+    if (op == NULL) {
+        return false;
+    }
+    switch (op->opc) {
+    case INDEX_op_br:
+    case INDEX_op_exit_tb:
+    case INDEX_op_goto_ptr:
+        return true;
+    case INDEX_op_call:
+        return tcg_call_flags(op) & TCG_CALL_NO_RETURN;
+    default:
+        return false;
+    }
+}
+
+/*
+ * At a label, all globals are in memory.  If the label is only reached
+ * by a single conditional branch, reload the register state recorded by
+ * tcg_reg_alloc_cbranch_label: those registers still hold the globals.
+ */
+static void tcg_reg_alloc_set_label(TCGContext *s, const TCGOp *op)
+{
+    TCGLabel *l = arg_label(op->args[0]);
+
+    tcg_reg_alloc_bb_end(s, s->reserved_regs);
+
+    if (l->reg_globals && label_no_fallthrough(op)) {
+        for (int i = 0; i < TCG_TARGET_NB_REGS; i++) {
+            TCGTemp *ts = l->reg_globals[i];
+
+            if (ts && ts->val_type == TEMP_VAL_MEM) {
+                set_temp_val_reg(s, ts, i);
+                ts->mem_coherent = 1;
+            }
+        }
+    }
+}
+
 /*
  * Specialized code generation for INDEX_op_mov_* with a constant.
  */
@@ -5283,6 +5371,7 @@ static void tcg_reg_alloc_op(TCGContext *s, const TCGOp *op)
 
     if (def->flags & TCG_OPF_COND_BRANCH) {
         tcg_reg_alloc_cbranch(s, i_allocated_regs);
+        tcg_reg_alloc_cbranch_label(s, op);
     } else if (def->flags & TCG_OPF_BB_END) {
         tcg_reg_alloc_bb_end(s, i_allocated_regs);
     } else {
@@ -6440,7 +6529,7 @@ int tcg_gen_code(TCGContext *s, TranslationBlock *tb, uint64_t pc_start)
             temp_dead(s, arg_temp(op->args[0]));
             break;
         case INDEX_op_set_label:
-            tcg_reg_alloc_bb_end(s, s->reserved_regs);
+            tcg_reg_alloc_set_label(s, op);
             tcg_out_label(s, arg_label(op->args[0]));
             break;
         case INDEX_op_call:
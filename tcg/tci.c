@@ -135,6 +135,18 @@ static void tci_args_rrbb(uint32_t insn, TCGReg *r0, TCGReg *r1,
     *i3 = extract32(insn, 22, 6);
 }
 
+static void tci_args_rrcl(uint32_t insn, const uint32_t **tb_ptr,
+                          TCGReg *r0, TCGReg *r1, TCGCond *c2, void **l3)
+{
+    const uint32_t *next = *tb_ptr + 1;
+
+    *r0 = extract32(insn, 8, 4);
+    *r1 = extract32(insn, 12, 4);
+    *c2 = extract32(insn, 16, 4);
+    *l3 = (void *)next + (int32_t)**tb_ptr;
+    *tb_ptr = next;
+}
+
 static void tci_args_rrrc(uint32_t insn,
                           TCGReg *r0, TCGReg *r1, TCGReg *r2, TCGCond *c3)
 {
@@ -356,6 +368,86 @@ uintptr_t QEMU_DISABLE_CFI tcg_qemu_tb_exec(CPUArchState *env,
     tcg_target_ulong regs[TCG_TARGET_NB_REGS];
     uint64_t stack[(TCG_STATIC_CALL_ARGS_SIZE + TCG_STATIC_FRAME_SIZE)
                    / sizeof(uint64_t)];
+    /*
+     * Jump straight to the code of the frequent opcodes, without the
+     * range check of the switch.  GCC and clang also copy this jump to
+     * the end of each opcode, so that the host predicts the next opcode
+     * from the current one instead of through a single shared jump.
+     * Other opcodes go through the switch.
+     */
+    static const void * const dispatch[NB_OPS] = {
+        [0 ... NB_OPS - 1] = &&op_switch,
+        [INDEX_op_call] = &&op_call,
+        [INDEX_op_br] = &&op_br,
+        [INDEX_op_setcond_i32] = &&op_setcond_i32,
+        [INDEX_op_movcond_i32] = &&op_movcond_i32,
+        [INDEX_op_mov_i32] = &&op_mov,
+        [INDEX_op_tci_movi] = &&op_tci_movi,
+        [INDEX_op_tci_movl] = &&op_tci_movl,
+        [INDEX_op_ld8u_i32] = &&op_ld8u,
+        [INDEX_op_ld8s_i32] = &&op_ld8s,
+        [INDEX_op_ld16u_i32] = &&op_ld16u,
+        [INDEX_op_ld16s_i32] = &&op_ld16s,
+        [INDEX_op_ld_i32] = &&op_ld32u,
+        [INDEX_op_st8_i32] = &&op_st8,
+        [INDEX_op_st16_i32] = &&op_st16,
+        [INDEX_op_st_i32] = &&op_st32,
+        [INDEX_op_add_i32] = &&op_add,
+        [INDEX_op_sub_i32] = &&op_sub,
+        [INDEX_op_mul_i32] = &&op_mul,
+        [INDEX_op_and_i32] = &&op_and,
+        [INDEX_op_or_i32] = &&op_or,
+        [INDEX_op_xor_i32] = &&op_xor,
+        [INDEX_op_shl_i32] = &&op_shl_i32,
+        [INDEX_op_shr_i32] = &&op_shr_i32,
+        [INDEX_op_sar_i32] = &&op_sar_i32,
+        [INDEX_op_deposit_i32] = &&op_deposit_i32,
+        [INDEX_op_extract_i32] = &&op_extract_i32,
+        [INDEX_op_sextract_i32] = &&op_sextract_i32,
+        [INDEX_op_tci_brcond_i32] = &&op_tci_brcond_i32,
+        [INDEX_op_neg_i32] = &&op_neg,
+        [INDEX_op_exit_tb] = &&op_exit_tb,
+        [INDEX_op_goto_tb] = &&op_goto_tb,
+        [INDEX_op_goto_ptr] = &&op_goto_ptr,
+        [INDEX_op_qemu_ld_i32] = &&op_qemu_ld_i32,
+        [INDEX_op_qemu_ld_i64] = &&op_qemu_ld_i64,
+        [INDEX_op_qemu_st_i32] = &&op_qemu_st_i32,
+        [INDEX_op_qemu_st_i64] = &&op_qemu_st_i64,
+#if TCG_TARGET_REG_BITS == 64
+        [INDEX_op_setcond_i64] = &&op_setcond_i64,
+        [INDEX_op_movcond_i64] = &&op_movcond_i64,
+        [INDEX_op_mov_i64] = &&op_mov,
+        [INDEX_op_ld8u_i64] = &&op_ld8u,
+        [INDEX_op_ld8s_i64] = &&op_ld8s,
+        [INDEX_op_ld16u_i64] = &&op_ld16u,
+        [INDEX_op_ld16s_i64] = &&op_ld16s,
+        [INDEX_op_ld32u_i64] = &&op_ld32u,
+        [INDEX_op_st8_i64] = &&op_st8,
+        [INDEX_op_st16_i64] = &&op_st16,
+        [INDEX_op_st32_i64] = &&op_st32,
+        [INDEX_op_add_i64] = &&op_add,
+        [INDEX_op_sub_i64] = &&op_sub,
+        [INDEX_op_mul_i64] = &&op_mul,
+        [INDEX_op_and_i64] = &&op_and,
+        [INDEX_op_or_i64] = &&op_or,
+        [INDEX_op_xor_i64] = &&op_xor,
+        [INDEX_op_neg_i64] = &&op_neg,
+        [INDEX_op_ld32s_i64] = &&op_ld32s_i64,
+        [INDEX_op_ld_i64] = &&op_ld_i64,
+        [INDEX_op_st_i64] = &&op_st_i64,
+        [INDEX_op_shl_i64] = &&op_shl_i64,
+        [INDEX_op_shr_i64] = &&op_shr_i64,
+        [INDEX_op_sar_i64] = &&op_sar_i64,
+        [INDEX_op_deposit_i64] = &&op_deposit_i64,
+        [INDEX_op_extract_i64] = &&op_extract_i64,
+        [INDEX_op_sextract_i64] = &&op_sextract_i64,
+        [INDEX_op_tci_brcond_i64] = &&op_tci_brcond_i64,
+        [INDEX_op_ext32s_i64] = &&op_ext32s_i64,
+        [INDEX_op_ext_i32_i64] = &&op_ext32s_i64,
+        [INDEX_op_ext32u_i64] = &&op_ext32u_i64,
+        [INDEX_op_extu_i32_i64] = &&op_ext32u_i64,
+#endif
+    };
 
     regs[TCG_AREG0] = (tcg_target_ulong)env;
     regs[TCG_REG_CALL_STACK] = (uintptr_t)stack;
@@ -378,8 +470,12 @@ uintptr_t QEMU_DISABLE_CFI tcg_qemu_tb_exec(CPUArchState *env,
         insn = *tb_ptr++;
         opc = extract32(insn, 0, 8);
 
+        goto *dispatch[opc];
+
+    op_switch:
         switch (opc) {
         case INDEX_op_call:
+        op_call:
             {
                 void *call_slots[MAX_CALL_IARGS];
                 ffi_cif *cif;
@@ -433,14 +529,17 @@ uintptr_t QEMU_DISABLE_CFI tcg_qemu_tb_exec(CPUArchState *env,
             break;
 
         case INDEX_op_br:
+        op_br:
             tci_args_l(insn, tb_ptr, &ptr);
             tb_ptr = ptr;
             continue;
         case INDEX_op_setcond_i32:
+        op_setcond_i32:
             tci_args_rrrc(insn, &r0, &r1, &r2, &condition);
             regs[r0] = tci_compare32(regs[r1], regs[r2], condition);
             break;
         case INDEX_op_movcond_i32:
+        op_movcond_i32:
             tci_args_rrrrrc(insn, &r0, &r1, &r2, &r3, &r4, &condition);
             tmp32 = tci_compare32(regs[r1], regs[r2], condition);
             regs[r0] = regs[tmp32 ? r3 : r4];
@@ -454,24 +553,29 @@ uintptr_t QEMU_DISABLE_CFI tcg_qemu_tb_exec(CPUArchState *env,
             break;
 #elif TCG_TARGET_REG_BITS == 64
         case INDEX_op_setcond_i64:
+        op_setcond_i64:
             tci_args_rrrc(insn, &r0, &r1, &r2, &condition);
             regs[r0] = tci_compare64(regs[r1], regs[r2], condition);
             break;
         case INDEX_op_movcond_i64:
+        op_movcond_i64:
             tci_args_rrrrrc(insn, &r0, &r1, &r2, &r3, &r4, &condition);
             tmp32 = tci_compare64(regs[r1], regs[r2], condition);
             regs[r0] = regs[tmp32 ? r3 : r4];
             break;
 #endif
         CASE_32_64(mov)
+        op_mov:
             tci_args_rr(insn, &r0, &r1);
             regs[r0] = regs[r1];
             break;
         case INDEX_op_tci_movi:
+        op_tci_movi:
             tci_args_ri(insn, &r0, &t1);
             regs[r0] = t1;
             break;
         case INDEX_op_tci_movl:
+        op_tci_movl:
             tci_args_rl(insn, tb_ptr, &r0, &ptr);
             regs[r0] = *(tcg_target_ulong *)ptr;
             break;
@@ -479,43 +583,51 @@ uintptr_t QEMU_DISABLE_CFI tcg_qemu_tb_exec(CPUArchState *env,
             /* Load/store operations (32 bit). */
 
         CASE_32_64(ld8u)
+        op_ld8u:
             tci_args_rrs(insn, &r0, &r1, &ofs);
             ptr = (void *)(regs[r1] + ofs);
             regs[r0] = *(uint8_t *)ptr;
             break;
         CASE_32_64(ld8s)
+        op_ld8s:
             tci_args_rrs(insn, &r0, &r1, &ofs);
             ptr = (void *)(regs[r1] + ofs);
             regs[r0] = *(int8_t *)ptr;
             break;
         CASE_32_64(ld16u)
+        op_ld16u:
             tci_args_rrs(insn, &r0, &r1, &ofs);
             ptr = (void *)(regs[r1] + ofs);
             regs[r0] = *(uint16_t *)ptr;
             break;
         CASE_32_64(ld16s)
+        op_ld16s:
             tci_args_rrs(insn, &r0, &r1, &ofs);
             ptr = (void *)(regs[r1] + ofs);
             regs[r0] = *(int16_t *)ptr;
             break;
         case INDEX_op_ld_i32:
         CASE_64(ld32u)
+        op_ld32u:
             tci_args_rrs(insn, &r0, &r1, &ofs);
             ptr = (void *)(regs[r1] + ofs);
             regs[r0] = *(uint32_t *)ptr;
             break;
         CASE_32_64(st8)
+        op_st8:
             tci_args_rrs(insn, &r0, &r1, &ofs);
             ptr = (void *)(regs[r1] + ofs);
             *(uint8_t *)ptr = regs[r0];
             break;
         CASE_32_64(st16)
+        op_st16:
             tci_args_rrs(insn, &r0, &r1, &ofs);
             ptr = (void *)(regs[r1] + ofs);
             *(uint16_t *)ptr = regs[r0];
             break;
         case INDEX_op_st_i32:
         CASE_64(st32)
+        op_st32:
             tci_args_rrs(insn, &r0, &r1, &ofs);
             ptr = (void *)(regs[r1] + ofs);
             *(uint32_t *)ptr = regs[r0];
@@ -524,26 +636,32 @@ uintptr_t QEMU_DISABLE_CFI tcg_qemu_tb_exec(CPUArchState *env,
             /* Arithmetic operations (mixed 32/64 bit). */
 
         CASE_32_64(add)
+        op_add:
             tci_args_rrr(insn, &r0, &r1, &r2);
             regs[r0] = regs[r1] + regs[r2];
             break;
         CASE_32_64(sub)
+        op_sub:
             tci_args_rrr(insn, &r0, &r1, &r2);
             regs[r0] = regs[r1] - regs[r2];
             break;
         CASE_32_64(mul)
+        op_mul:
             tci_args_rrr(insn, &r0, &r1, &r2);
             regs[r0] = regs[r1] * regs[r2];
             break;
         CASE_32_64(and)
+        op_and:
             tci_args_rrr(insn, &r0, &r1, &r2);
             regs[r0] = regs[r1] & regs[r2];
             break;
         CASE_32_64(or)
+        op_or:
             tci_args_rrr(insn, &r0, &r1, &r2);
             regs[r0] = regs[r1] | regs[r2];
             break;
         CASE_32_64(xor)
+        op_xor:
             tci_args_rrr(insn, &r0, &r1, &r2);
             regs[r0] = regs[r1] ^ regs[r2];
             break;
@@ -620,14 +738,17 @@ uintptr_t QEMU_DISABLE_CFI tcg_qemu_tb_exec(CPUArchState *env,
             /* Shift/rotate operations (32 bit). */
 
         case INDEX_op_shl_i32:
+        op_shl_i32:
             tci_args_rrr(insn, &r0, &r1, &r2);
             regs[r0] = (uint32_t)regs[r1] << (regs[r2] & 31);
             break;
         case INDEX_op_shr_i32:
+        op_shr_i32:
             tci_args_rrr(insn, &r0, &r1, &r2);
             regs[r0] = (uint32_t)regs[r1] >> (regs[r2] & 31);
             break;
         case INDEX_op_sar_i32:
+        op_sar_i32:
             tci_args_rrr(insn, &r0, &r1, &r2);
             regs[r0] = (int32_t)regs[r1] >> (regs[r2] & 31);
             break;
@@ -642,23 +763,36 @@ uintptr_t QEMU_DISABLE_CFI tcg_qemu_tb_exec(CPUArchState *env,
             break;
 #endif
         case INDEX_op_deposit_i32:
+        op_deposit_i32:
             tci_args_rrrbb(insn, &r0, &r1, &r2, &pos, &len);
             regs[r0] = deposit32(regs[r1], pos, len, regs[r2]);
             break;
         case INDEX_op_extract_i32:
+        op_extract_i32:
             tci_args_rrbb(insn, &r0, &r1, &pos, &len);
             regs[r0] = extract32(regs[r1], pos, len);
             break;
         case INDEX_op_sextract_i32:
+        op_sextract_i32:
             tci_args_rrbb(insn, &r0, &r1, &pos, &len);
             regs[r0] = sextract32(regs[r1], pos, len);
             break;
+#if TCG_TARGET_REG_BITS == 32
         case INDEX_op_brcond_i32:
+            /* Only emitted for brcond2_i32, after setcond2_i32. */
             tci_args_rl(insn, tb_ptr, &r0, &ptr);
             if ((uint32_t)regs[r0]) {
                 tb_ptr = ptr;
             }
             break;
+#endif
+        case INDEX_op_tci_brcond_i32:
+        op_tci_brcond_i32:
+            tci_args_rrcl(insn, &tb_ptr, &r0, &r1, &condition, &ptr);
+            if (tci_compare32(regs[r0], regs[r1], condition)) {
+                tb_ptr = ptr;
+            }
+            break;
 #if TCG_TARGET_REG_BITS == 32 || TCG_TARGET_HAS_add2_i32
         case INDEX_op_add2_i32:
             tci_args_rrrrrr(insn, &r0, &r1, &r2, &r3, &r4, &r5);
@@ -733,6 +867,7 @@ uintptr_t QEMU_DISABLE_CFI tcg_qemu_tb_exec(CPUArchState *env,
             break;
 #endif
         CASE_32_64(neg)
+        op_neg:
             tci_args_rr(insn, &r0, &r1);
             regs[r0] = -regs[r1];
             break;
@@ -740,16 +875,19 @@ uintptr_t QEMU_DISABLE_CFI tcg_qemu_tb_exec(CPUArchState *env,
             /* Load/store operations (64 bit). */
 
         case INDEX_op_ld32s_i64:
+        op_ld32s_i64:
             tci_args_rrs(insn, &r0, &r1, &ofs);
             ptr = (void *)(regs[r1] + ofs);
             regs[r0] = *(int32_t *)ptr;
             break;
         case INDEX_op_ld_i64:
+        op_ld_i64:
             tci_args_rrs(insn, &r0, &r1, &ofs);
             ptr = (void *)(regs[r1] + ofs);
             regs[r0] = *(uint64_t *)ptr;
             break;
         case INDEX_op_st_i64:
+        op_st_i64:
             tci_args_rrs(insn, &r0, &r1, &ofs);
             ptr = (void *)(regs[r1] + ofs);
             *(uint64_t *)ptr = regs[r0];
@@ -825,14 +963,17 @@ uintptr_t QEMU_DISABLE_CFI tcg_qemu_tb_exec(CPUArchState *env,
             /* Shift/rotate operations (64 bit). */
 
         case INDEX_op_shl_i64:
+        op_shl_i64:
             tci_args_rrr(insn, &r0, &r1, &r2);
             regs[r0] = regs[r1] << (regs[r2] & 63);
             break;
         case INDEX_op_shr_i64:
+        op_shr_i64:
             tci_args_rrr(insn, &r0, &r1, &r2);
             regs[r0] = regs[r1] >> (regs[r2] & 63);
             break;
         case INDEX_op_sar_i64:
+        op_sar_i64:
             tci_args_rrr(insn, &r0, &r1, &r2);
             regs[r0] = (int64_t)regs[r1] >> (regs[r2] & 63);
             break;
@@ -847,30 +988,36 @@ uintptr_t QEMU_DISABLE_CFI tcg_qemu_tb_exec(CPUArchState *env,
             break;
 #endif
         case INDEX_op_deposit_i64:
+        op_deposit_i64:
             tci_args_rrrbb(insn, &r0, &r1, &r2, &pos, &len);
             regs[r0] = deposit64(regs[r1], pos, len, regs[r2]);
             break;
         case INDEX_op_extract_i64:
+        op_extract_i64:
             tci_args_rrbb(insn, &r0, &r1, &pos, &len);
             regs[r0] = extract64(regs[r1], pos, len);
             break;
         case INDEX_op_sextract_i64:
+        op_sextract_i64:
             tci_args_rrbb(insn, &r0, &r1, &pos, &len);
             regs[r0] = sextract64(regs[r1], pos, len);
             break;
-        case INDEX_op_brcond_i64:
-            tci_args_rl(insn, tb_ptr, &r0, &ptr);
-            if (regs[r0]) {
+        case INDEX_op_tci_brcond_i64:
+        op_tci_brcond_i64:
+            tci_args_rrcl(insn, &tb_ptr, &r0, &r1, &condition, &ptr);
+            if (tci_compare64(regs[r0], regs[r1], condition)) {
                 tb_ptr = ptr;
             }
             break;
         case INDEX_op_ext32s_i64:
         case INDEX_op_ext_i32_i64:
+        op_ext32s_i64:
             tci_args_rr(insn, &r0, &r1);
             regs[r0] = (int32_t)regs[r1];
             break;
         case INDEX_op_ext32u_i64:
         case INDEX_op_extu_i32_i64:
+        op_ext32u_i64:
             tci_args_rr(insn, &r0, &r1);
             regs[r0] = (uint32_t)regs[r1];
             break;
@@ -885,15 +1032,18 @@ uintptr_t QEMU_DISABLE_CFI tcg_qemu_tb_exec(CPUArchState *env,
             /* QEMU specific operations. */
 
         case INDEX_op_exit_tb:
+        op_exit_tb:
             tci_args_l(insn, tb_ptr, &ptr);
             return (uintptr_t)ptr;
 
         case INDEX_op_goto_tb:
+        op_goto_tb:
             tci_args_l(insn, tb_ptr, &ptr);
             tb_ptr = *(void **)ptr;
             break;
 
         case INDEX_op_goto_ptr:
+        op_goto_ptr:
             tci_args_r(insn, &r0);
             ptr = (void *)regs[r0];
             if (!ptr) {
@@ -903,12 +1053,14 @@ uintptr_t QEMU_DISABLE_CFI tcg_qemu_tb_exec(CPUArchState *env,
             break;
 
         case INDEX_op_qemu_ld_i32:
+        op_qemu_ld_i32:
             tci_args_rrm(insn, &r0, &r1, &oi);
             taddr = regs[r1];
             regs[r0] = tci_qemu_ld(env, taddr, oi, tb_ptr);
             break;
 
         case INDEX_op_qemu_ld_i64:
+        op_qemu_ld_i64:
             if (TCG_TARGET_REG_BITS == 64) {
                 tci_args_rrm(insn, &r0, &r1, &oi);
                 taddr = regs[r1];
@@ -926,12 +1078,14 @@ uintptr_t QEMU_DISABLE_CFI tcg_qemu_tb_exec(CPUArchState *env,
             break;
 
         case INDEX_op_qemu_st_i32:
+        op_qemu_st_i32:
             tci_args_rrm(insn, &r0, &r1, &oi);
             taddr = regs[r1];
             tci_qemu_st(env, taddr, regs[r0], oi, tb_ptr);
             break;
 
         case INDEX_op_qemu_st_i64:
+        op_qemu_st_i64:
             if (TCG_TARGET_REG_BITS == 64) {
                 tci_args_rrm(insn, &r0, &r1, &oi);
                 tmp64 = regs[r0];
@@ -1041,12 +1195,18 @@ int print_insn_tci(bfd_vma addr, disassemble_info *info)
         break;
 
     case INDEX_op_brcond_i32:
-    case INDEX_op_brcond_i64:
         tci_args_rl(insn, tb_ptr, &r0, &ptr);
         info->fprintf_func(info->stream, "%-12s  %s, 0, ne, %p",
                            op_name, str_r(r0), ptr);
         break;
 
+    case INDEX_op_tci_brcond_i32:
+    case INDEX_op_tci_brcond_i64:
+        tci_args_rrcl(insn, &tb_ptr, &r0, &r1, &c, &ptr);
+        info->fprintf_func(info->stream, "%-12s  %s, %s, %s, %p",
+                           op_name, str_r(r0), str_r(r1), str_c(c), ptr);
+        return 2 * sizeof(insn);
+
     case INDEX_op_setcond_i32:
     case INDEX_op_setcond_i64:
         tci_args_rrrc(insn, &r0, &r1, &r2, &c);
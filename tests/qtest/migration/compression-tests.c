@@ -41,6 +41,24 @@ static void test_multifd_tcp_zstd(void)
 }
 #endif /* CONFIG_ZSTD */
 
+#ifdef CONFIG_LZ4
+static void *
+migrate_hook_start_precopy_tcp_multifd_lz4(QTestState *from,
+                                           QTestState *to)
+{
+    return migrate_hook_start_precopy_tcp_multifd_common(from, to, "lz4");
+}
+
+static void test_multifd_tcp_lz4(void)
+{
+    MigrateCommon args = {
+        .listen_uri = "defer",
+        .start_hook = migrate_hook_start_precopy_tcp_multifd_lz4,
+    };
+    test_precopy_common(&args);
+}
+#endif /* CONFIG_LZ4 */
+
 #ifdef CONFIG_QATZIP
 static void *
 migrate_hook_start_precopy_tcp_multifd_qatzip(QTestState *from,
@@ -151,6 +169,73 @@ static void test_multifd_tcp_zlib(void)
     test_precopy_common(&args);
 }
 
+static void *
+migrate_hook_start_precopy_tcp_multifd_xbzrle(QTestState *from,
+                                              QTestState *to)
+{
+    migrate_set_parameter_int(from, "xbzrle-cache-size", 33554432);
+
+    return migrate_hook_start_precopy_tcp_multifd_common(from, to, "xbzrle");
+}
+
+static void test_multifd_tcp_xbzrle(void)
+{
+    MigrateCommon args = {
+        .listen_uri = "defer",
+        .start_hook = migrate_hook_start_precopy_tcp_multifd_xbzrle,
+        .iterations = 2,
+        /*
+         * As for legacy XBZRLE, pages must be modified between rounds for
+         * deltas to be sent.
+         */
+        .live = true,
+    };
+    test_precopy_common(&args);
+}
+
+static void migrate_set_parameter_str_fail(QTestState *who,
+                                           const char *parameter,
+                                           const char *value,
+                                           const char *error)
+{
+    QDict *rsp;
+
+    rsp = qtest_qmp(who, "{ 'execute': 'migrate-set-parameters',"
+                         "  'arguments': { %s: %s } }", parameter, value);
+    g_assert_true(qdict_haskey(rsp, "error"));
+    g_assert_cmpstr(qdict_get_str(qdict_get_qdict(rsp, "error"), "desc"),
+                    ==, error);
+    qobject_unref(rsp);
+}
+
+/*
+ * Legacy zero pages bypass multifd, so the xbzrle cache would miss them:
+ * the combination must be refused whichever parameter is set first.
+ */
+static void test_multifd_xbzrle_zero_page_legacy(void)
+{
+    const char *error = "Multifd xbzrle compression is not compatible with "
+                        "legacy zero page detection";
+    MigrateStart args = {
+        .hide_stderr = true,
+    };
+    QTestState *from, *to;
+
+    if (migrate_start(&from, &to, "defer", &args)) {
+        return;
+    }
+
+    migrate_set_parameter_str(from, "multifd-compression", "xbzrle");
+    migrate_set_parameter_str_fail(from, "zero-page-detection", "legacy",
+                                   error);
+
+    migrate_set_parameter_str(to, "zero-page-detection", "legacy");
+    migrate_set_parameter_str_fail(to, "multifd-compression", "xbzrle",
+                                   error);
+
+    migrate_end(from, to, false);
+}
+
 static void migration_test_add_compression_smoke(MigrationTestEnv *env)
 {
     migration_test_add("/migration/multifd/tcp/plain/zlib",
@@ -167,11 +252,21 @@ void migration_test_add_compression(MigrationTestEnv *env)
         return;
     }
 
+    migration_test_add("/migration/multifd/tcp/plain/xbzrle",
+                       test_multifd_tcp_xbzrle);
+    migration_test_add("/migration/multifd/xbzrle/zero-page-legacy",
+                       test_multifd_xbzrle_zero_page_legacy);
+
 #ifdef CONFIG_ZSTD
     migration_test_add("/migration/multifd/tcp/plain/zstd",
                        test_multifd_tcp_zstd);
 #endif
 
+#ifdef CONFIG_LZ4
+    migration_test_add("/migration/multifd/tcp/plain/lz4",
+                       test_multifd_tcp_lz4);
+#endif
+
 #ifdef CONFIG_QATZIP
     migration_test_add("/migration/multifd/tcp/plain/qatzip",
                        test_multifd_tcp_qatzip);
@@ -13,6 +13,7 @@
 #include "qemu/osdep.h"
 #include "libqtest.h"
 #include "migration/framework.h"
+#include "migration/migration-qmp.h"
 #include "migration/migration-util.h"
 #include "qobject/qlist.h"
 #include "qemu/module.h"
@@ -45,6 +46,37 @@ static void test_postcopy_preempt(void)
     test_postcopy_common(&args);
 }
 
+static void *migrate_hook_start_postcopy_prefetch(QTestState *from,
+                                                  QTestState *to)
+{
+    QDict *rsp;
+
+    /* the guest dirties memory sequentially, so the stride is one page */
+    migrate_set_parameter_int(to, "postcopy-prefetch-pages", 64);
+
+    /* more than MAX_POSTCOPY_PREFETCH_PAGES is rejected */
+    rsp = qtest_qmp_assert_failure_ref(
+        to, "{ 'execute': 'migrate-set-parameters',"
+            "'arguments': { 'postcopy-prefetch-pages': 257 } }");
+    qobject_unref(rsp);
+
+    return NULL;
+}
+
+static void test_postcopy_preempt_prefetch(void)
+{
+    MigrateCommon args = {
+        .postcopy_preempt = true,
+        .start_hook = migrate_hook_start_postcopy_prefetch,
+    };
+
+    /*
+     * How many pages fault depends on timing, so only check that the
+     * prefetched pages leave the guest RAM intact.
+     */
+    test_postcopy_common(&args);
+}
+
 static void test_postcopy_recovery(void)
 {
     MigrateCommon args = { };
@@ -102,6 +134,9 @@ void migration_test_add_postcopy(MigrationTestEnv *env)
         migration_test_add("/migration/postcopy/preempt/recovery/plain",
                            test_postcopy_preempt_recovery);
 
+        migration_test_add("/migration/postcopy/preempt/prefetch",
+                           test_postcopy_preempt_prefetch);
+
         migration_test_add(
             "/migration/postcopy/recovery/double-failures/handshake",
             test_postcopy_recovery_fail_handshake);
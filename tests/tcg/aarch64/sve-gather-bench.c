@@ -0,0 +1,95 @@
+/*
+ * SVE gather microbenchmark
+ *
+ * Repeatedly gather 64-bit elements, either all from one page or each
+ * from a different page, and report the nanoseconds taken per element
+ * for several vector lengths.  Gathers from one page show the cost of
+ * the per-element loads once the page has been probed; gathers across
+ * pages show the cost of the probe itself.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/prctl.h>
+
+#define PAGE_WORDS  (4096 / 8)
+#define NELEM       (256 / 8)
+#define NDATA       (NELEM * PAGE_WORDS)
+#define ROUNDS      20000
+
+static uint64_t data[NDATA] __attribute__((aligned(4096)));
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static uint64_t __attribute__((noinline)) bench(int vl, int stride,
+                                                uint64_t *sum)
+{
+    uint64_t idx[NELEM], out[NELEM];
+    int n = vl / 8;
+    uint64_t start, acc = 0;
+
+    for (int i = 0; i < n; ++i) {
+        idx[i] = i * stride;
+    }
+
+    start = now_ns();
+    for (int r = 0; r < ROUNDS; ++r) {
+        asm volatile (
+            "ptrue p0.d\n\t"
+            "ld1d z1.d, p0/z, [%1]\n\t"
+            "ld1d z0.d, p0/z, [%2, z1.d, lsl #3]\n\t"
+            "st1d z0.d, p0, [%0]"
+            : : "r" (out), "r" (idx), "r" (data)
+            : "z0", "z1", "p0", "memory");
+        acc += out[r % n];
+    }
+    *sum = acc;
+    return now_ns() - start;
+}
+
+static const int strides[] = { 1, PAGE_WORDS };
+static const char * const stride_names[] = { "one page", "one page each" };
+
+int main()
+{
+    int err = 0;
+
+    for (int i = 0; i < NDATA; ++i) {
+        data[i] = i;
+    }
+
+    for (int vl = 16; vl <= 256; vl *= 2) {
+        if (prctl(PR_SVE_SET_VL, vl, 0, 0, 0, 0) != vl) {
+            continue;
+        }
+        for (int s = 0; s < 2; ++s) {
+            int n = vl / 8;
+            uint64_t sum, exp = 0;
+            uint64_t ns = bench(vl, strides[s], &sum);
+
+            /* Round r returns element r % n, i.e. data[(r % n) * stride]. */
+            for (int r = 0; r < ROUNDS; ++r) {
+                exp += (uint64_t)(r % n) * strides[s];
+            }
+            if (sum != exp) {
+                fprintf(stderr, "vl %d, %s: expected %llu, got %llu\n",
+                        vl, stride_names[s], (unsigned long long)exp,
+                        (unsigned long long)sum);
+                err = 1;
+            }
+            printf("vl %3d, %-13s: %llu ns per element\n",
+                   vl, stride_names[s],
+                   (unsigned long long)(ns / ((uint64_t)ROUNDS * n)));
+        }
+    }
+    return err;
+}
@@ -0,0 +1,66 @@
+/*
+ * Check SVE gather loads whose elements move between pages
+ * and return to pages touched by earlier elements.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/prctl.h>
+
+#define NDATA  (3 * 4096 / 8)
+#define NELEM  (256 / 8)
+
+static uint64_t data[NDATA] __attribute__((aligned(4096)));
+
+static int __attribute__((noinline)) test(int vl)
+{
+    uint64_t idx[NELEM], out[NELEM];
+    int n = vl / 8;
+    int err = 0;
+
+    for (int act = 0; act <= n; ++act) {
+        for (int i = 0; i < n; ++i) {
+            idx[i] = (i * 517 + act) % NDATA;
+            out[i] = -1;
+        }
+
+        asm volatile (
+            "whilelo p0.d, xzr, %3\n\t"
+            "ptrue p1.d\n\t"
+            "ld1d z1.d, p1/z, [%1]\n\t"
+            "ld1d z0.d, p0/z, [%2, z1.d, lsl #3]\n\t"
+            "st1d z0.d, p1, [%0]"
+            : : "r" (out), "r" (idx), "r" (data), "r" ((uint64_t)act)
+            : "z0", "z1", "p0", "p1", "memory");
+
+        for (int i = 0; i < n; ++i) {
+            uint64_t exp = i < act ? data[idx[i]] : 0;
+            if (out[i] != exp) {
+                fprintf(stderr, "vl %d, active %d, index %d: "
+                        "expected %#llx, got %#llx\n", vl, act, i,
+                        (unsigned long long)exp,
+                        (unsigned long long)out[i]);
+                err = 1;
+            }
+        }
+    }
+    return err;
+}
+
+int main()
+{
+    int err = 0;
+
+    for (int i = 0; i < NDATA; ++i) {
+        data[i] = (uint64_t)i * 0x0001000100010001ull + 1;
+    }
+
+    for (int i = 16; i <= 256; i += 16) {
+        if (prctl(PR_SVE_SET_VL, i, 0, 0, 0, 0) == i) {
+            err |= test(i);
+        }
+    }
+    return err;
+}
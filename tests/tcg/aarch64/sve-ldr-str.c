@@ -0,0 +1,43 @@
+/*
+ * Copy memory with SVE LDR/STR of whole vector registers.
+ *
+ * With vectors longer than 64 bytes, these are translated to a loop
+ * over 16-byte accesses.  Run under the mem plugin with trace buffers,
+ * this checks that every iteration of that loop is recorded without
+ * overrunning the buffer.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+#include <stdio.h>
+#include <string.h>
+
+#define MAX_VL  256
+#define ROUNDS  100
+
+static unsigned char src[MAX_VL], dst[MAX_VL];
+
+int main(void)
+{
+    unsigned long vl;
+
+    asm("rdvl %0, #1" : "=r"(vl));
+
+    for (int i = 0; i < MAX_VL; i++) {
+        src[i] = i;
+    }
+
+    for (int r = 0; r < ROUNDS; r++) {
+        memset(dst, r, sizeof(dst));
+        asm volatile("ldr z0, [%0]\n\t"
+                     "str z0, [%1]"
+                     : : "r"(src), "r"(dst) : "z0", "memory");
+        for (int i = 0; i < vl; i++) {
+            if (dst[i] != src[i]) {
+                fprintf(stderr, "round %d, index %d, expected %d, got %d\n",
+                        r, i, src[i], dst[i]);
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
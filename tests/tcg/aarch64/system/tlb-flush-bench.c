@@ -0,0 +1,67 @@
+/*
+ * TLB flush microbenchmark
+ *
+ * Repeatedly invalidate the whole stage 1 TLB, as a guest switching
+ * address spaces without ASIDs does, and touch a few pages after each
+ * invalidation.  Report the virtual counter ticks taken per round for
+ * several working set sizes.  The largest set runs first, so that the
+ * softmmu TLB has grown when the small ones run.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <stdint.h>
+#include <minilib.h>
+
+#define PAGE_SIZE   4096
+#define MAX_PAGES   256
+#define ROUNDS      2000
+
+static uint8_t pages[MAX_PAGES][PAGE_SIZE] __attribute__((aligned(PAGE_SIZE)));
+
+static uint64_t read_cntvct(void)
+{
+    uint64_t val;
+
+    asm volatile("isb\n\t"
+                 "mrs %0, cntvct_el0" : "=r"(val));
+    return val;
+}
+
+static uint64_t bench(int n_pages)
+{
+    uint64_t start = read_cntvct();
+
+    for (int r = 0; r < ROUNDS; r++) {
+        asm volatile("tlbi vmalle1\n\t"
+                     "dsb ish\n\t"
+                     "isb" : : : "memory");
+        for (int i = 0; i < n_pages; i++) {
+            pages[i][0]++;
+        }
+    }
+    return read_cntvct() - start;
+}
+
+static const int sizes[] = { 256, 64, 16, 4 };
+#define N_SIZES (sizeof(sizes) / sizeof(sizes[0]))
+
+int main(void)
+{
+    for (int i = 0; i < N_SIZES; i++) {
+        uint64_t ticks = bench(sizes[i]);
+
+        ml_printf("%d pages: %ld ticks per round\n",
+                  sizes[i], ticks / ROUNDS);
+    }
+
+    /* The smallest set was written in every round of every size. */
+    for (int i = 0; i < sizes[N_SIZES - 1]; i++) {
+        if (pages[i][0] != (uint8_t)(ROUNDS * N_SIZES)) {
+            ml_printf("FAIL: page %d has %d\n", i, pages[i][0]);
+            return 1;
+        }
+    }
+    ml_printf("OK\n");
+    return 0;
+}
@@ -16,6 +16,7 @@
 typedef struct {
     uint64_t count_tb;
     uint64_t count_tb_inline;
+    uint64_t count_tb_exit_inline;
     uint64_t count_insn;
     uint64_t count_insn_inline;
     uint64_t count_mem;
@@ -37,6 +38,7 @@ typedef struct {
 static struct qemu_plugin_scoreboard *counts;
 static qemu_plugin_u64 count_tb;
 static qemu_plugin_u64 count_tb_inline;
+static qemu_plugin_u64 count_tb_exit_inline;
 static qemu_plugin_u64 count_insn;
 static qemu_plugin_u64 count_insn_inline;
 static qemu_plugin_u64 count_mem;
@@ -89,6 +91,7 @@ static void stats_tb(void)
     const uint64_t per_vcpu = qemu_plugin_u64_sum(count_tb);
     const uint64_t inl_per_vcpu =
         qemu_plugin_u64_sum(count_tb_inline);
+    const uint64_t exits = qemu_plugin_u64_sum(count_tb_exit_inline);
     const uint64_t cond_num_trigger = qemu_plugin_u64_sum(tb_cond_num_trigger);
     const uint64_t cond_track_left = qemu_plugin_u64_sum(tb_cond_track_count);
     const uint64_t conditional =
@@ -98,11 +101,14 @@ static void stats_tb(void)
     g_string_append_printf(stats, "tb: %" PRIu64 " (per vcpu)\n", per_vcpu);
     g_string_append_printf(stats, "tb: %" PRIu64 " (per vcpu inline)\n", inl_per_vcpu);
     g_string_append_printf(stats, "tb: %" PRIu64 " (conditional cb)\n", conditional);
+    g_string_append_printf(stats, "tb: %" PRIu64 " (exits inline)\n", exits);
     qemu_plugin_outs(stats->str);
     g_assert(expected > 0);
     g_assert(per_vcpu == expected);
     g_assert(inl_per_vcpu == expected);
     g_assert(conditional == expected);
+    /* blocks left through an exception do not count an exit */
+    g_assert(exits > 0 && exits <= expected);
 }
 
 static void stats_mem(void)
@@ -239,6 +245,14 @@ static void vcpu_tb_trans(qemu_plugin_id_t id, struct qemu_plugin_tb *tb)
         tb, vcpu_tb_cond_exec, QEMU_PLUGIN_CB_NO_REGS,
         QEMU_PLUGIN_COND_EQ, tb_cond_track_count, cond_trigger_limit, tb_store);
 
+    for (int exit = QEMU_PLUGIN_TB_EXIT_DIRECT0;
+         exit <= QEMU_PLUGIN_TB_EXIT_INDIRECT; ++exit) {
+        if (qemu_plugin_tb_has_exit(tb, exit)) {
+            qemu_plugin_register_vcpu_tb_exit_inline_per_vcpu(
+                tb, exit, QEMU_PLUGIN_INLINE_ADD_U64, count_tb_exit_inline, 1);
+        }
+    }
+
     for (int idx = 0; idx < qemu_plugin_tb_n_insns(tb); ++idx) {
         struct qemu_plugin_insn *insn = qemu_plugin_tb_get_insn(tb, idx);
         void *insn_store = insn;
@@ -286,6 +300,8 @@ int qemu_plugin_install(qemu_plugin_id_t id, const qemu_info_t *info,
         counts, CPUCount, count_mem);
     count_tb_inline = qemu_plugin_scoreboard_u64_in_struct(
         counts, CPUCount, count_tb_inline);
+    count_tb_exit_inline = qemu_plugin_scoreboard_u64_in_struct(
+        counts, CPUCount, count_tb_exit_inline);
     count_insn_inline = qemu_plugin_scoreboard_u64_in_struct(
         counts, CPUCount, count_insn_inline);
     count_mem_inline = qemu_plugin_scoreboard_u64_in_struct(
@@ -56,11 +56,15 @@ typedef struct {
     bool     seen_all;
 } RegionInfo;
 
+/* the smallest buffer, to drain often */
+#define MEM_BUFFER_RECORDS 64
+
 static struct qemu_plugin_scoreboard *counts;
 static qemu_plugin_u64 mem_count;
 static qemu_plugin_u64 io_count;
 static bool do_inline, do_callback, do_print_accesses, do_region_summary;
-static bool do_haddr;
+static bool do_haddr, do_buffer;
+static struct qemu_plugin_mem_buffer *mem_buffer;
 static enum qemu_plugin_mem_rw rw = QEMU_PLUGIN_MEM_RW;
 
 
@@ -80,7 +84,13 @@ static void plugin_exit(qemu_plugin_id_t id, void *p)
 {
     g_autoptr(GString) out = g_string_new("");
 
-    if (do_inline || do_callback) {
+    if (do_buffer) {
+        for (int i = 0; i < qemu_plugin_num_vcpus(); i++) {
+            qemu_plugin_mem_buffer_flush(mem_buffer, i);
+        }
+    }
+
+    if (do_inline || do_callback || do_buffer) {
         g_string_printf(out, "mem accesses: %" PRIu64 "\n",
                         qemu_plugin_u64_sum(mem_count));
     }
@@ -114,9 +124,21 @@ static void plugin_exit(qemu_plugin_id_t id, void *p)
         qemu_plugin_outs(out->str);
     }
 
+    if (do_buffer) {
+        qemu_plugin_mem_buffer_free(mem_buffer);
+    }
     qemu_plugin_scoreboard_free(counts);
 }
 
+static void vcpu_mem_buffer(unsigned int cpu_index,
+                            const qemu_plugin_mem_record *records,
+                            size_t n, void *udata)
+{
+    /* more records would have overrun the buffer */
+    g_assert(n <= MEM_BUFFER_RECORDS);
+    qemu_plugin_u64_add(mem_count, cpu_index, n);
+}
+
 /*
  * Update the region tracking info for the access. We split up accesses
  * that span regions even though the plugin infrastructure will deliver
@@ -305,6 +327,18 @@ static void vcpu_tb_trans(qemu_plugin_id_t id, struct qemu_plugin_tb *tb)
                 QEMU_PLUGIN_INLINE_ADD_U64,
                 mem_count, 1);
         }
+        if (do_buffer && rw == QEMU_PLUGIN_MEM_RW) {
+            /*
+             * Each access matches one of the two, but room is reserved
+             * for both, so that wide instructions overflow the buffer.
+             */
+            qemu_plugin_register_vcpu_mem_buffer(insn, QEMU_PLUGIN_MEM_R,
+                                                 mem_buffer);
+            qemu_plugin_register_vcpu_mem_buffer(insn, QEMU_PLUGIN_MEM_W,
+                                                 mem_buffer);
+        } else if (do_buffer) {
+            qemu_plugin_register_vcpu_mem_buffer(insn, rw, mem_buffer);
+        }
         if (do_callback || do_region_summary) {
             qemu_plugin_register_vcpu_mem_cb(insn, vcpu_mem,
                                              QEMU_PLUGIN_CB_NO_REGS,
@@ -358,6 +392,11 @@ QEMU_PLUGIN_EXPORT int qemu_plugin_install(qemu_plugin_id_t id,
                 fprintf(stderr, "boolean argument parsing failed: %s\n", opt);
                 return -1;
             }
+        } else if (g_strcmp0(tokens[0], "buffer") == 0) {
+            if (!qemu_plugin_bool_parse(tokens[0], tokens[1], &do_buffer)) {
+                fprintf(stderr, "boolean argument parsing failed: %s\n", opt);
+                return -1;
+            }
         } else if (g_strcmp0(tokens[0], "print-accesses") == 0) {
             if (!qemu_plugin_bool_parse(tokens[0], tokens[1],
                                         &do_print_accesses)) {
@@ -376,9 +415,10 @@ QEMU_PLUGIN_EXPORT int qemu_plugin_install(qemu_plugin_id_t id,
         }
     }
 
-    if (do_inline && do_callback) {
+    if (do_inline + do_callback + do_buffer > 1) {
         fprintf(stderr,
-                "can't enable inline and callback counting at the same time\n");
+                "can't enable more than one of inline, callback and buffer "
+                "counting at the same time\n");
         return -1;
     }
 
@@ -399,6 +439,10 @@ QEMU_PLUGIN_EXPORT int qemu_plugin_install(qemu_plugin_id_t id,
     mem_count = qemu_plugin_scoreboard_u64_in_struct(
         counts, CPUCount, mem_count);
     io_count = qemu_plugin_scoreboard_u64_in_struct(counts, CPUCount, io_count);
+    if (do_buffer) {
+        mem_buffer = qemu_plugin_mem_buffer_new(MEM_BUFFER_RECORDS,
+                                                vcpu_mem_buffer, NULL);
+    }
     qemu_plugin_register_vcpu_tb_trans_cb(id, vcpu_tb_trans);
     qemu_plugin_register_atexit_cb(id, plugin_exit, NULL);
     return 0;
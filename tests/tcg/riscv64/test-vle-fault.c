@@ -0,0 +1,115 @@
+/*
+ * Check vstart and the fault address of unit-stride vector loads and
+ * stores that cross into an inaccessible page.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+#include <assert.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/* Elements accessible before the page boundary */
+#define HEAD 5
+
+static sigjmp_buf jmp_env;
+static volatile uintptr_t fault_vstart;
+static void * volatile fault_addr;
+
+static void sigsegv_handler(int sig, siginfo_t *info, void *puc)
+{
+    uintptr_t vstart;
+
+    /* Read vstart before anything can touch the vector unit. */
+    asm volatile(".option push\n\t"
+                 ".option arch, +v\n\t"
+                 "csrr %0, vstart\n\t"
+                 ".option pop" : "=r"(vstart));
+    fault_vstart = vstart;
+    fault_addr = info->si_addr;
+    siglongjmp(jmp_env, 1);
+}
+
+static uintptr_t vlmax_e8(void)
+{
+    uintptr_t vl;
+
+    asm volatile(".option push\n\t"
+                 ".option arch, +v\n\t"
+                 "vsetvli %0, zero, e8, m1, ta, ma\n\t"
+                 ".option pop" : "=r"(vl));
+    return vl;
+}
+
+static void vle8(void *p)
+{
+    asm volatile(".option push\n\t"
+                 ".option arch, +v\n\t"
+                 "vsetvli t0, zero, e8, m1, ta, ma\n\t"
+                 "vle8.v v8, (%0)\n\t"
+                 ".option pop" : : "r"(p) : "t0", "memory");
+}
+
+static void vse8(void *p)
+{
+    asm volatile(".option push\n\t"
+                 ".option arch, +v\n\t"
+                 "vsetvli t0, zero, e8, m1, ta, ma\n\t"
+                 "vmv.v.i v8, 1\n\t"
+                 "vse8.v v8, (%0)\n\t"
+                 ".option pop" : : "r"(p) : "t0", "memory");
+}
+
+static void check_fault(const char *name, void (*fn)(void *), uint8_t *p,
+                        uint8_t *boundary)
+{
+    fault_addr = NULL;
+    fault_vstart = -1;
+    if (sigsetjmp(jmp_env, 1) == 0) {
+        fn(p);
+        printf("%s: no fault\n", name);
+        assert(0);
+    }
+    printf("%s: vstart %lu, fault at +%ld\n", name,
+           (unsigned long)fault_vstart, (long)((uint8_t *)fault_addr - p));
+    assert(fault_vstart == HEAD);
+    assert(fault_addr == boundary);
+}
+
+int main(void)
+{
+    struct sigaction sa = {
+        .sa_sigaction = sigsegv_handler,
+        .sa_flags = SA_SIGINFO,
+    };
+    long page_size = sysconf(_SC_PAGESIZE);
+    uint8_t *buf, *boundary, *p;
+
+    if (vlmax_e8() <= HEAD) {
+        printf("vectors too short, skipping\n");
+        return 0;
+    }
+
+    buf = mmap(NULL, 2 * page_size, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    assert(buf != MAP_FAILED);
+    boundary = buf + page_size;
+    assert(mprotect(boundary, page_size, PROT_NONE) == 0);
+    assert(sigaction(SIGSEGV, &sa, NULL) == 0);
+
+    p = boundary - HEAD;
+    memset(buf, 0, page_size);
+
+    check_fault("vle8", vle8, p, boundary);
+    check_fault("vse8", vse8, p, boundary);
+
+    /* The elements before the fault were stored. */
+    for (int i = 0; i < HEAD; i++) {
+        assert(p[i] == 1);
+    }
+    return 0;
+}